@@ -0,0 +1,236 @@
+#include "AssetPrefetcher.h"
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include "Trace.h"
+
+AssetPrefetcher::AssetPrefetcher(const std::string& baseDirectory, size_t lookaheadLines, size_t memoryBudget)
+    : baseDirectory(baseDirectory), lookaheadLines(lookaheadLines), memoryBudget(memoryBudget) {}
+
+AssetPrefetcher::~AssetPrefetcher() {
+    stop();
+    for (auto& [path, entry] : entries) {
+        release(entry.image);
+    }
+}
+
+void AssetPrefetcher::setCompressedFormats(uint32_t formats) {
+    compressedFormats = formats;
+}
+
+void AssetPrefetcher::setReadyEvent(uint32_t eventType) {
+    readyEvent = eventType;
+}
+
+void AssetPrefetcher::start() {
+    if (worker.joinable() || lookaheadLines == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+    }
+    worker = std::thread(&AssetPrefetcher::workerLoop, this);
+}
+
+void AssetPrefetcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorker.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+std::string AssetPrefetcher::resolvePath(const std::string& path) const {
+    if (baseDirectory.empty() || path.empty() || path[0] == '/' || path[0] == '\\' || path.find(':') != std::string::npos) {
+        return path;
+    }
+    return baseDirectory + "/" + path;
+}
+
+size_t AssetPrefetcher::imageBytes(const DecodedImage& image) {
+    if (image.compressed) return image.compressed->blocks.size();
+    return image.surface ? static_cast<size_t>(image.surface->pitch) * image.surface->h : 0;
+}
+
+void AssetPrefetcher::release(DecodedImage& image) {
+    if (image.surface) SDL_FreeSurface(image.surface);
+    image = {};
+}
+
+DecodedImage AssetPrefetcher::decode(const std::string& path) const {
+    VNE_TRACE_SCOPE("AssetPrefetcher::decode");
+    DecodedImage image;
+    std::string imagePath = resolvePath(path);
+    std::string vtcPath = compressedTexturePath(imagePath);
+    std::error_code ec;
+    // Устаревшая сжатая копия игнорируется: исходник правили после сжатия
+    if (std::filesystem::exists(vtcPath, ec) &&
+        !(std::filesystem::exists(imagePath, ec) &&
+          std::filesystem::last_write_time(imagePath, ec) > std::filesystem::last_write_time(vtcPath, ec))) {
+        auto texture = std::make_shared<CompressedTexture>();
+        if (!readCompressedTexture(vtcPath, *texture)) {
+            std::cerr << "Invalid compressed texture: " << vtcPath << ", using " << path << "\n";
+        } else if (compressedFormats & textureFormatBit(texture->format)) {
+            image.compressed = std::move(texture);
+            return image;
+        } else {
+            image.surface = decompressTexture(*texture);
+            if (image.surface) return image;
+        }
+    }
+
+    SDL_Surface* loaded = IMG_Load(imagePath.c_str());
+    if (!loaded) {
+        std::cerr << "Failed to load image " << path << ": " << IMG_GetError() << "\n";
+        return image;
+    }
+    if (loaded->format->format == SDL_PIXELFORMAT_RGBA32) {
+        image.surface = loaded;
+        return image;
+    }
+    image.surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    return image;
+}
+
+void AssetPrefetcher::scan(const ScriptSource& script, size_t fromLine) {
+    if (lookaheadLines == 0) return;
+    size_t until = std::min(script.lineCount(), fromLine + lookaheadLines);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // После перехода назад или далеко вперёд окно просмотра начинается заново
+    size_t begin = (scannedUntil < fromLine || scannedUntil > until) ? fromLine : scannedUntil;
+    bool queued = false;
+    for (size_t i = begin; i < until; i++) {
+        scanBuffer.clear();
+        script.assetReferences(i, scanBuffer);
+        for (const auto& ref : scanBuffer) {
+            if (ref.kind != AssetKind::Image) continue;
+            auto [it, inserted] = entries.try_emplace(std::string(ref.path));
+            if (inserted) {
+                requestQueue.push_back(it->first);
+                queued = true;
+            }
+        }
+    }
+    scannedUntil = std::max(begin, until);
+    if (queued) wakeWorker.notify_one();
+}
+
+void AssetPrefetcher::workerLoop() {
+    VNE_TRACE_THREAD_NAME("AssetPrefetcher");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeWorker.wait(lock, [this] {
+            return stopping || (!requestQueue.empty() && counters.pendingBytes < memoryBudget);
+        });
+        if (stopping) return;
+
+        std::string path = std::move(requestQueue.front());
+        requestQueue.pop_front();
+        auto it = entries.find(path);
+        if (it == entries.end() || it->second.state != EntryState::Queued) continue;
+        it->second.state = EntryState::Decoding;
+
+        lock.unlock();
+        DecodedImage image = decode(path);
+        lock.lock();
+
+        it = entries.find(path);
+        if (it == entries.end() || it->second.state != EntryState::Decoding) {
+            // Пока шло декодирование, запись забрали или забыли
+            release(image);
+        } else if (!image) {
+            counters.failed++;
+            it->second.state = EntryState::Taken;
+        } else {
+            counters.decoded++;
+            counters.pendingBytes += imageBytes(image);
+            it->second.image = std::move(image);
+            it->second.state = EntryState::Ready;
+            readyQueue.push_back(path);
+            // Пока очередь не пуста, цикл и так не засыпает надолго — одного события достаточно
+            if (readyEvent && readyQueue.size() == 1) {
+                SDL_Event event = {};
+                event.type = readyEvent;
+                SDL_PushEvent(&event);
+            }
+        }
+        wakeWorker.notify_all(); // Будит acquire(), ожидающий этот файл
+    }
+}
+
+bool AssetPrefetcher::popDecoded(std::string& path, DecodedImage& image) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!readyQueue.empty()) {
+        path = std::move(readyQueue.front());
+        readyQueue.pop_front();
+        auto it = entries.find(path);
+        if (it == entries.end() || it->second.state != EntryState::Ready) continue;
+
+        image = std::move(it->second.image);
+        it->second.image = {};
+        it->second.state = EntryState::Taken;
+        counters.pendingBytes -= imageBytes(image);
+        wakeWorker.notify_all();
+        return true;
+    }
+    return false;
+}
+
+DecodedImage AssetPrefetcher::acquire(const std::string& path) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it != entries.end() && it->second.state == EntryState::Decoding) {
+        // Файл уже декодируется: дождаться его дешевле, чем декодировать второй раз
+        wakeWorker.wait(lock, [&] {
+            it = entries.find(path);
+            return stopping || it == entries.end() || it->second.state != EntryState::Decoding;
+        });
+    }
+
+    if (it != entries.end() && it->second.state == EntryState::Ready) {
+        DecodedImage image = std::move(it->second.image);
+        it->second.image = {};
+        it->second.state = EntryState::Taken;
+        counters.pendingBytes -= imageBytes(image);
+        counters.hits++;
+        readyQueue.erase(std::find(readyQueue.begin(), readyQueue.end(), path));
+        wakeWorker.notify_all();
+        return image;
+    }
+
+    entries[path].state = EntryState::Taken;
+    counters.misses++;
+    lock.unlock();
+    return decode(path);
+}
+
+void AssetPrefetcher::recordHit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.hits++;
+}
+
+void AssetPrefetcher::forget(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) return;
+    if (it->second.state == EntryState::Ready) {
+        counters.pendingBytes -= imageBytes(it->second.image);
+        release(it->second.image);
+        readyQueue.erase(std::find(readyQueue.begin(), readyQueue.end(), path));
+    }
+    entries.erase(it);
+    scannedUntil = 0; // Освобождённый файл снова попадёт в окно при следующем просмотре
+}
+
+bool AssetPrefetcher::hasDecoded() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !readyQueue.empty();
+}
+
+PrefetchStats AssetPrefetcher::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
@@ -0,0 +1,100 @@
+#ifndef ASSET_PREFETCHER_H
+#define ASSET_PREFETCHER_H
+
+#include "ScriptSource.h"
+#include "CompressedTexture.h"
+#include <SDL2/SDL.h>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+struct PrefetchStats {
+    uint64_t hits = 0;          // Изображение было готово к моменту обращения
+    uint64_t misses = 0;        // Пришлось декодировать синхронно на кадровом потоке
+    uint64_t decoded = 0;       // Декодировано фоновым потоком
+    uint64_t failed = 0;        // Ошибки декодирования
+    size_t pendingBytes = 0;    // Декодировано, но ещё не передано на загрузку
+};
+
+// Декодированное изображение: RGBA32-поверхность или сжатые блоки, которые модуль рендеринга читает сам
+struct DecodedImage {
+    SDL_Surface* surface = nullptr;
+    std::shared_ptr<CompressedTexture> compressed;
+
+    explicit operator bool() const { return surface || compressed; }
+};
+
+// Фоновая подгрузка изображений, на которые ссылаются ближайшие строки сценария.
+// Декодирование идёт в отдельном потоке, загрузка на GPU — на кадровом потоке через popDecoded().
+class AssetPrefetcher {
+private:
+    enum class EntryState { Queued, Decoding, Ready, Taken };
+
+    struct Entry {
+        EntryState state = EntryState::Queued;
+        DecodedImage image;
+    };
+
+    std::string baseDirectory;
+    size_t lookaheadLines;
+    size_t memoryBudget;
+    std::atomic<uint32_t> compressedFormats{0};
+    uint32_t readyEvent = 0; // Тип события SDL о готовом изображении; 0 — не отправлять
+
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable wakeWorker;
+    bool stopping = false;
+    std::deque<std::string> requestQueue;
+    std::deque<std::string> readyQueue;
+    std::unordered_map<std::string, Entry> entries;
+    size_t scannedUntil = 0; // Строки до этой границы уже просмотрены
+    PrefetchStats counters;
+    std::vector<AssetReference> scanBuffer;
+
+    void workerLoop();
+    std::string resolvePath(const std::string& path) const;
+    static size_t imageBytes(const DecodedImage& image);
+    static void release(DecodedImage& image);
+
+public:
+    AssetPrefetcher(const std::string& baseDirectory, size_t lookaheadLines, size_t memoryBudget);
+    ~AssetPrefetcher();
+    AssetPrefetcher(const AssetPrefetcher&) = delete;
+    AssetPrefetcher& operator=(const AssetPrefetcher&) = delete;
+
+    // Сжатые форматы, которые модуль рендеринга загружает без распаковки; задаётся до start()
+    void setCompressedFormats(uint32_t formats);
+    // Событие, которое фоновый поток отправляет, когда очередь готовых изображений перестаёт быть пустой:
+    // будит главный цикл, ждущий ввода. Задаётся до start()
+    void setReadyEvent(uint32_t eventType);
+    void start();
+    void stop();
+
+    // Ставит в очередь изображения из строк [fromLine, fromLine + lookaheadLines)
+    void scan(const ScriptSource& script, size_t fromLine);
+    // Следующее декодированное изображение для загрузки на GPU; владение поверхностью переходит вызывающему
+    bool popDecoded(std::string& path, DecodedImage& image);
+    // Изображение для немедленного использования: готовое из кэша или декодированное синхронно (промах)
+    DecodedImage acquire(const std::string& path);
+    // Отмечает обращение к уже загруженному изображению
+    void recordHit();
+    // Разрешает повторную подгрузку (например, после выгрузки текстуры)
+    void forget(const std::string& path);
+    // Декодирование в формат, который ожидают модули рендеринга (RGBA32). Свежая сжатая копия (.vtc)
+    // рядом с файлом берётся вместо него и распаковывается, только если модуль не читает её формат.
+    DecodedImage decode(const std::string& path) const;
+
+    // Есть ли декодированные изображения, ожидающие загрузки на GPU
+    bool hasDecoded() const;
+
+    PrefetchStats stats() const;
+};
+
+#endif // ASSET_PREFETCHER_H
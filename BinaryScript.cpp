@@ -0,0 +1,211 @@
+#include "BinaryScript.h"
+#include <fstream>
+#include <unordered_map>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+VnbOpcode classifyLine(std::string_view line) {
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) return VnbOpcode::Blank;
+    std::string_view rest = line.substr(first);
+    if (rest[0] == '#' || rest.compare(0, 2, "//") == 0) return VnbOpcode::Comment;
+    return VnbOpcode::Text;
+}
+
+uint32_t alignTo4(uint32_t value) {
+    return (value + 3u) & ~3u;
+}
+
+// Таблица строк с дедупликацией: одинаковые реплики и пути хранятся один раз
+class StringTableBuilder {
+private:
+    std::unordered_map<std::string, uint32_t> indices;
+    std::vector<uint32_t> offsets{0};
+    std::string data;
+
+public:
+    uint32_t intern(std::string_view value) {
+        auto [it, inserted] = indices.try_emplace(std::string(value), static_cast<uint32_t>(offsets.size() - 1));
+        if (inserted) {
+            data.append(value.data(), value.size());
+            offsets.push_back(static_cast<uint32_t>(data.size()));
+        }
+        return it->second;
+    }
+
+    uint32_t count() const { return static_cast<uint32_t>(offsets.size() - 1); }
+    const std::vector<uint32_t>& stringOffsets() const { return offsets; }
+    const std::string& stringData() const { return data; }
+};
+
+} // namespace
+
+std::string binaryScriptPath(const std::string& scriptPath) {
+    size_t slash = scriptPath.find_last_of("/\\");
+    size_t dot = scriptPath.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return scriptPath + ".vnb";
+    return scriptPath.substr(0, dot) + ".vnb";
+}
+
+bool compileScript(const ScriptSource& source, const std::string& outputPath, std::string& error) {
+    if (source.lineCount() > std::numeric_limits<uint32_t>::max()) {
+        error = "Script has too many lines";
+        return false;
+    }
+
+    StringTableBuilder strings;
+    std::vector<VnbInstruction> instructions;
+    std::vector<VnbAsset> assets;
+    std::vector<AssetReference> lineAssets;
+    instructions.reserve(source.lineCount());
+
+    for (size_t i = 0; i < source.lineCount(); i++) {
+        std::string_view text = source.line(i);
+        VnbInstruction instruction = {};
+        instruction.opcode = static_cast<uint8_t>(classifyLine(text));
+        instruction.stringIndex = strings.intern(text);
+        instruction.firstAsset = static_cast<uint32_t>(assets.size());
+
+        lineAssets.clear();
+        findAssetReferences(text, lineAssets);
+        if (lineAssets.size() > std::numeric_limits<uint16_t>::max()) {
+            error = "Too many asset references on line " + std::to_string(i + 1);
+            return false;
+        }
+        for (const auto& ref : lineAssets) {
+            VnbAsset asset = {};
+            asset.stringIndex = strings.intern(ref.path);
+            asset.lineIndex = static_cast<uint32_t>(i);
+            asset.kind = static_cast<uint8_t>(ref.kind);
+            assets.push_back(asset);
+        }
+        instruction.assetCount = static_cast<uint16_t>(lineAssets.size());
+        instructions.push_back(instruction);
+    }
+
+    uint64_t totalSize = sizeof(VnbHeader) + instructions.size() * sizeof(VnbInstruction) + assets.size() * sizeof(VnbAsset) +
+                         strings.stringOffsets().size() * sizeof(uint32_t) + strings.stringData().size();
+    if (totalSize > std::numeric_limits<uint32_t>::max()) {
+        error = "Compiled script exceeds 4 GiB";
+        return false;
+    }
+
+    VnbHeader header = {};
+    std::memcpy(header.magic, VNB_MAGIC, sizeof(header.magic));
+    header.version = VNB_VERSION;
+    header.instructionCount = static_cast<uint32_t>(instructions.size());
+    header.assetCount = static_cast<uint32_t>(assets.size());
+    header.stringCount = strings.count();
+    header.stringDataSize = static_cast<uint32_t>(strings.stringData().size());
+    header.instructionsOffset = sizeof(VnbHeader);
+    header.assetsOffset = header.instructionsOffset + header.instructionCount * sizeof(VnbInstruction);
+    header.stringOffsetsOffset = header.assetsOffset + header.assetCount * sizeof(VnbAsset);
+    header.stringDataOffset = alignTo4(header.stringOffsetsOffset + (header.stringCount + 1) * sizeof(uint32_t));
+
+    std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        error = "Could not open output file: " + outputPath;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(instructions.data()), instructions.size() * sizeof(VnbInstruction));
+    out.write(reinterpret_cast<const char*>(assets.data()), assets.size() * sizeof(VnbAsset));
+    out.write(reinterpret_cast<const char*>(strings.stringOffsets().data()), strings.stringOffsets().size() * sizeof(uint32_t));
+    const char padding[4] = {};
+    out.write(padding, header.stringDataOffset - (header.stringOffsetsOffset + (header.stringCount + 1) * sizeof(uint32_t)));
+    out.write(strings.stringData().data(), strings.stringData().size());
+    if (!out.good()) {
+        error = "Failed to write compiled script: " + outputPath;
+        return false;
+    }
+    return true;
+}
+
+bool BinaryScriptSource::open(const std::string& path) {
+    header = nullptr;
+    if (!file.open(path)) return false;
+
+    const char* data = file.data();
+    uint64_t size = file.size();
+    if (size < sizeof(VnbHeader)) {
+        file.close();
+        return false;
+    }
+    const VnbHeader* candidate = reinterpret_cast<const VnbHeader*>(data);
+    bool valid = std::memcmp(candidate->magic, VNB_MAGIC, sizeof(candidate->magic)) == 0 &&
+                 candidate->version == VNB_VERSION &&
+                 uint64_t(candidate->instructionsOffset) + uint64_t(candidate->instructionCount) * sizeof(VnbInstruction) <= size &&
+                 uint64_t(candidate->assetsOffset) + uint64_t(candidate->assetCount) * sizeof(VnbAsset) <= size &&
+                 uint64_t(candidate->stringOffsetsOffset) + (uint64_t(candidate->stringCount) + 1) * sizeof(uint32_t) <= size &&
+                 uint64_t(candidate->stringDataOffset) + candidate->stringDataSize <= size &&
+                 candidate->instructionsOffset % 4 == 0 && candidate->assetsOffset % 4 == 0 && candidate->stringOffsetsOffset % 4 == 0;
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    header = candidate;
+    instructions = reinterpret_cast<const VnbInstruction*>(data + header->instructionsOffset);
+    assets = reinterpret_cast<const VnbAsset*>(data + header->assetsOffset);
+    stringOffsets = reinterpret_cast<const uint32_t*>(data + header->stringOffsetsOffset);
+    stringData = data + header->stringDataOffset;
+
+    // Индексы проверяются один раз при загрузке, чтобы line() обходилась без проверок
+    if (stringOffsets[header->stringCount] > header->stringDataSize) valid = false;
+    for (uint32_t i = 0; valid && i < header->stringCount; i++) {
+        if (stringOffsets[i] > stringOffsets[i + 1]) valid = false;
+    }
+    for (uint32_t i = 0; valid && i < header->instructionCount; i++) {
+        const VnbInstruction& instruction = instructions[i];
+        if (instruction.stringIndex >= header->stringCount ||
+            uint64_t(instruction.firstAsset) + instruction.assetCount > header->assetCount) {
+            valid = false;
+        }
+    }
+    for (uint32_t i = 0; valid && i < header->assetCount; i++) {
+        if (assets[i].stringIndex >= header->stringCount) valid = false;
+    }
+    if (!valid) {
+        header = nullptr;
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+std::string_view BinaryScriptSource::string(uint32_t index) const {
+    return std::string_view(stringData + stringOffsets[index], stringOffsets[index + 1] - stringOffsets[index]);
+}
+
+size_t BinaryScriptSource::lineCount() const {
+    return header ? header->instructionCount : 0;
+}
+
+std::string_view BinaryScriptSource::line(size_t index) const {
+    return string(instructions[index].stringIndex);
+}
+
+void BinaryScriptSource::assetReferences(size_t index, std::vector<AssetReference>& out) const {
+    const VnbInstruction& instruction = instructions[index];
+    for (uint32_t i = 0; i < instruction.assetCount; i++) {
+        out.push_back(asset(instruction.firstAsset + i));
+    }
+}
+
+VnbOpcode BinaryScriptSource::opcode(size_t index) const {
+    return static_cast<VnbOpcode>(instructions[index].opcode);
+}
+
+size_t BinaryScriptSource::assetCount() const {
+    return header ? header->assetCount : 0;
+}
+
+AssetReference BinaryScriptSource::asset(size_t index) const {
+    return {string(assets[index].stringIndex), static_cast<AssetKind>(assets[index].kind)};
+}
+
+size_t BinaryScriptSource::assetLine(size_t index) const {
+    return assets[index].lineIndex;
+}
@@ -0,0 +1,90 @@
+#ifndef BINARY_SCRIPT_H
+#define BINARY_SCRIPT_H
+
+#include "ScriptSource.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Формат скомпилированного сценария (.vnb). Все секции выровнены по 4 байта
+// и читаются прямо из отображённого файла, без разбора и копирования.
+//
+//   VnbHeader
+//   VnbInstruction[instructionCount]  — по одной инструкции на строку сценария
+//   VnbAsset[assetCount]              — ресурсы в порядке строк
+//   uint32_t[stringCount + 1]         — смещения строк в блоке данных
+//   char[stringDataSize]              — строки без завершающего нуля (дедуплицированы)
+
+constexpr char VNB_MAGIC[4] = {'V', 'N', 'B', '1'};
+constexpr uint32_t VNB_VERSION = 1;
+
+enum class VnbOpcode : uint8_t {
+    Text = 0,    // Обычная строка сценария
+    Blank = 1,   // Пустая строка или только пробелы
+    Comment = 2  // Строка, начинающаяся с '#' или '//'
+};
+
+struct VnbHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t instructionCount;
+    uint32_t assetCount;
+    uint32_t stringCount;
+    uint32_t stringDataSize;
+    uint32_t instructionsOffset;
+    uint32_t assetsOffset;
+    uint32_t stringOffsetsOffset;
+    uint32_t stringDataOffset;
+};
+
+struct VnbInstruction {
+    uint8_t opcode;
+    uint8_t reserved;
+    uint16_t assetCount;
+    uint32_t stringIndex; // Исходный текст строки
+    uint32_t firstAsset;  // Индекс первой ссылки в таблице ресурсов
+};
+
+struct VnbAsset {
+    uint32_t stringIndex; // Путь к ресурсу
+    uint32_t lineIndex;
+    uint8_t kind;         // AssetKind
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(VnbHeader) == 40, "VnbHeader layout must be stable");
+static_assert(sizeof(VnbInstruction) == 12, "VnbInstruction layout must be stable");
+static_assert(sizeof(VnbAsset) == 12, "VnbAsset layout must be stable");
+
+// Компилирует текстовый сценарий в .vnb. Возвращает false и текст ошибки в error.
+bool compileScript(const ScriptSource& source, const std::string& outputPath, std::string& error);
+
+// Путь к скомпилированному сценарию рядом с текстовым (script.txt -> script.vnb)
+std::string binaryScriptPath(const std::string& scriptPath);
+
+// Скомпилированный сценарий, загруженный без копирования из отображённого файла
+class BinaryScriptSource : public ScriptSource {
+private:
+    MappedFile file;
+    const VnbHeader* header = nullptr;
+    const VnbInstruction* instructions = nullptr;
+    const VnbAsset* assets = nullptr;
+    const uint32_t* stringOffsets = nullptr;
+    const char* stringData = nullptr;
+
+    std::string_view string(uint32_t index) const;
+
+public:
+    bool open(const std::string& path);
+    size_t lineCount() const override;
+    std::string_view line(size_t index) const override;
+    void assetReferences(size_t index, std::vector<AssetReference>& out) const override;
+
+    VnbOpcode opcode(size_t index) const;
+    // Полная таблица ресурсов: позволяет узнать всё, что нужно сцене, до её запуска
+    size_t assetCount() const;
+    AssetReference asset(size_t index) const;
+    size_t assetLine(size_t index) const;
+};
+
+#endif // BINARY_SCRIPT_H
@@ -0,0 +1,337 @@
+#include "CompressedTexture.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace {
+
+struct Color {
+    int r, g, b;
+};
+
+uint16_t packColor565(const Color& c) {
+    int r = (c.r * 31 + 127) / 255;
+    int g = (c.g * 63 + 127) / 255;
+    int b = (c.b * 31 + 127) / 255;
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+Color unpackColor565(uint16_t value) {
+    int r = (value >> 11) & 31;
+    int g = (value >> 5) & 63;
+    int b = value & 31;
+    return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+}
+
+int colorDistance(const Color& a, const uint8_t* pixel) {
+    int dr = a.r - pixel[0];
+    int dg = a.g - pixel[1];
+    int db = a.b - pixel[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+void writeLE16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+uint16_t readLE16(const uint8_t* in) {
+    return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+// Палитра цветового блока; в режиме трёх цветов четвёртый — прозрачный чёрный
+void colorPalette(uint16_t c0, uint16_t c1, bool fourColors, Color palette[4]) {
+    palette[0] = unpackColor565(c0);
+    palette[1] = unpackColor565(c1);
+    if (fourColors) {
+        palette[2] = {(2 * palette[0].r + palette[1].r) / 3, (2 * palette[0].g + palette[1].g) / 3, (2 * palette[0].b + palette[1].b) / 3};
+        palette[3] = {(palette[0].r + 2 * palette[1].r) / 3, (palette[0].g + 2 * palette[1].g) / 3, (palette[0].b + 2 * palette[1].b) / 3};
+    } else {
+        palette[2] = {(palette[0].r + palette[1].r) / 2, (palette[0].g + palette[1].g) / 2, (palette[0].b + palette[1].b) / 2};
+        palette[3] = {0, 0, 0};
+    }
+}
+
+// Концы отрезка — крайние пиксели блока вдоль главной оси разброса цветов
+void encodeColorBlock(const uint8_t pixels[64], uint8_t out[8]) {
+    float mean[3] = {};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) mean[c] += pixels[i * 4 + c];
+    }
+    for (float& m : mean) m /= 16.0f;
+
+    float cov[6] = {}; // rr, rg, rb, gg, gb, bb
+    for (int i = 0; i < 16; i++) {
+        float r = pixels[i * 4] - mean[0];
+        float g = pixels[i * 4 + 1] - mean[1];
+        float b = pixels[i * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max({std::fabs(x), std::fabs(y), std::fabs(z)});
+        if (length < 1e-6f) break; // Однотонный блок: подойдёт любая ось
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    int minIndex = 0, maxIndex = 0;
+    float minDot = std::numeric_limits<float>::max();
+    float maxDot = std::numeric_limits<float>::lowest();
+    for (int i = 0; i < 16; i++) {
+        float dot = pixels[i * 4] * axis[0] + pixels[i * 4 + 1] * axis[1] + pixels[i * 4 + 2] * axis[2];
+        if (dot < minDot) { minDot = dot; minIndex = i; }
+        if (dot > maxDot) { maxDot = dot; maxIndex = i; }
+    }
+    const uint8_t* high = pixels + maxIndex * 4;
+    const uint8_t* low = pixels + minIndex * 4;
+    uint16_t c0 = packColor565({high[0], high[1], high[2]});
+    uint16_t c1 = packColor565({low[0], low[1], low[2]});
+    // c0 > c1 включает режим четырёх цветов без прозрачности
+    if (c0 < c1) std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        Color palette[4];
+        colorPalette(c0, c1, true, palette);
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestDistance = colorDistance(palette[0], pixels + i * 4);
+            for (int p = 1; p < 4; p++) {
+                int distance = colorDistance(palette[p], pixels + i * 4);
+                if (distance < bestDistance) { bestDistance = distance; best = p; }
+            }
+            indices |= static_cast<uint32_t>(best) << (i * 2);
+        }
+    }
+    writeLE16(out, c0);
+    writeLE16(out + 2, c1);
+    for (int i = 0; i < 4; i++) out[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+}
+
+void decodeColorBlock(const uint8_t in[8], bool alwaysFourColors, uint8_t pixels[64]) {
+    uint16_t c0 = readLE16(in);
+    uint16_t c1 = readLE16(in + 2);
+    bool fourColors = alwaysFourColors || c0 > c1;
+    Color palette[4];
+    colorPalette(c0, c1, fourColors, palette);
+    uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+    for (int i = 0; i < 16; i++) {
+        uint32_t index = (indices >> (i * 2)) & 3;
+        const Color& color = palette[index];
+        pixels[i * 4] = static_cast<uint8_t>(color.r);
+        pixels[i * 4 + 1] = static_cast<uint8_t>(color.g);
+        pixels[i * 4 + 2] = static_cast<uint8_t>(color.b);
+        pixels[i * 4 + 3] = (!fourColors && index == 3) ? 0 : 255;
+    }
+}
+
+void alphaPalette(uint8_t a0, uint8_t a1, uint8_t palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; i++) palette[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1) / 7);
+    } else {
+        for (int i = 1; i < 5; i++) palette[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Блок альфы BC3: восемь уровней между максимумом и минимумом блока
+void encodeAlphaBlock(const uint8_t pixels[64], uint8_t out[8]) {
+    uint8_t a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, pixels[i * 4 + 3]);
+        a1 = std::min(a1, pixels[i * 4 + 3]);
+    }
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        uint8_t palette[8];
+        alphaPalette(a0, a1, palette);
+        for (int i = 0; i < 16; i++) {
+            int alpha = pixels[i * 4 + 3];
+            int best = 0;
+            int bestDistance = 256;
+            for (int p = 0; p < 8; p++) {
+                int distance = std::abs(palette[p] - alpha);
+                if (distance < bestDistance) { bestDistance = distance; best = p; }
+            }
+            indices |= static_cast<uint64_t>(best) << (i * 3);
+        }
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; i++) out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+}
+
+void decodeAlphaBlock(const uint8_t in[8], uint8_t pixels[64]) {
+    uint8_t palette[8];
+    alphaPalette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) indices |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+    for (int i = 0; i < 16; i++) pixels[i * 4 + 3] = palette[(indices >> (i * 3)) & 7];
+}
+
+// Поверхность в RGBA32; исходная возвращается как есть, если уже в этом формате
+SDL_Surface* toRgba(SDL_Surface* surface) {
+    if (surface->format->format == SDL_PIXELFORMAT_RGBA32) return surface;
+    return SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+}
+
+} // namespace
+
+size_t compressedBlockBytes(TextureFormat format) {
+    return format == TextureFormat::BC1 ? 8 : 16;
+}
+
+size_t compressedDataSize(TextureFormat format, int width, int height) {
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(format);
+}
+
+TextureFormat chooseTextureFormat(SDL_Surface* surface) {
+    SDL_Surface* rgba = toRgba(surface);
+    if (!rgba) return TextureFormat::BC3;
+    bool opaque = true;
+    for (int y = 0; opaque && y < rgba->h; y++) {
+        const uint8_t* row = static_cast<const uint8_t*>(rgba->pixels) + static_cast<size_t>(y) * rgba->pitch;
+        for (int x = 0; x < rgba->w; x++) {
+            if (row[x * 4 + 3] != 255) {
+                opaque = false;
+                break;
+            }
+        }
+    }
+    if (rgba != surface) SDL_FreeSurface(rgba);
+    return opaque ? TextureFormat::BC1 : TextureFormat::BC3;
+}
+
+bool compressTexture(SDL_Surface* surface, TextureFormat format, CompressedTexture& texture, std::string& error) {
+    SDL_Surface* rgba = toRgba(surface);
+    if (!rgba) {
+        error = "Failed to convert surface: " + std::string(SDL_GetError());
+        return false;
+    }
+
+    texture.format = format;
+    texture.width = rgba->w;
+    texture.height = rgba->h;
+    texture.blocks.resize(compressedDataSize(format, rgba->w, rgba->h));
+    size_t blockBytes = compressedBlockBytes(format);
+    uint8_t* out = texture.blocks.data();
+    const uint8_t* pixels = static_cast<const uint8_t*>(rgba->pixels);
+    uint8_t block[64];
+    for (int by = 0; by < rgba->h; by += 4) {
+        for (int bx = 0; bx < rgba->w; bx += 4) {
+            // Неполные блоки у края дополняются повтором крайних пикселей
+            for (int i = 0; i < 16; i++) {
+                int x = std::min(bx + i % 4, rgba->w - 1);
+                int y = std::min(by + i / 4, rgba->h - 1);
+                std::memcpy(block + i * 4, pixels + static_cast<size_t>(y) * rgba->pitch + x * 4, 4);
+            }
+            if (format == TextureFormat::BC3) {
+                encodeAlphaBlock(block, out);
+                encodeColorBlock(block, out + 8);
+            } else {
+                encodeColorBlock(block, out);
+            }
+            out += blockBytes;
+        }
+    }
+    if (rgba != surface) SDL_FreeSurface(rgba);
+    return true;
+}
+
+bool writeCompressedTexture(const CompressedTexture& texture, const std::string& outputPath, std::string& error) {
+    if (texture.blocks.size() != compressedDataSize(texture.format, texture.width, texture.height)) {
+        error = "Compressed texture data size does not match its dimensions";
+        return false;
+    }
+    VtcHeader header = {};
+    std::memcpy(header.magic, VTC_MAGIC, sizeof(header.magic));
+    header.version = VTC_VERSION;
+    header.format = static_cast<uint32_t>(texture.format);
+    header.width = static_cast<uint32_t>(texture.width);
+    header.height = static_cast<uint32_t>(texture.height);
+    header.dataSize = static_cast<uint32_t>(texture.blocks.size());
+
+    std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        error = "Could not open output file: " + outputPath;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(texture.blocks.data()), texture.blocks.size());
+    if (!out.good()) {
+        error = "Failed to write compressed texture: " + outputPath;
+        return false;
+    }
+    return true;
+}
+
+bool readCompressedTexture(const std::string& path, CompressedTexture& texture) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    VtcHeader header = {};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    const uint32_t maxDimension = 1u << 16;
+    if (std::memcmp(header.magic, VTC_MAGIC, sizeof(header.magic)) != 0 || header.version != VTC_VERSION ||
+        header.format > static_cast<uint32_t>(TextureFormat::BC3) || header.width == 0 || header.height == 0 ||
+        header.width > maxDimension || header.height > maxDimension) {
+        return false;
+    }
+    TextureFormat format = static_cast<TextureFormat>(header.format);
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    if (header.dataSize != compressedDataSize(format, width, height)) return false;
+
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    texture.blocks.resize(header.dataSize);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(texture.blocks.data()), header.dataSize));
+}
+
+SDL_Surface* decompressTexture(const CompressedTexture& texture) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, texture.width, texture.height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!surface) return nullptr;
+
+    size_t blockBytes = compressedBlockBytes(texture.format);
+    const uint8_t* in = texture.blocks.data();
+    uint8_t* pixels = static_cast<uint8_t*>(surface->pixels);
+    uint8_t block[64];
+    for (int by = 0; by < texture.height; by += 4) {
+        for (int bx = 0; bx < texture.width; bx += 4) {
+            if (texture.format == TextureFormat::BC3) {
+                decodeColorBlock(in + 8, true, block);
+                decodeAlphaBlock(in, block);
+            } else {
+                decodeColorBlock(in, false, block);
+            }
+            in += blockBytes;
+
+            int w = std::min(4, texture.width - bx);
+            int h = std::min(4, texture.height - by);
+            for (int row = 0; row < h; row++) {
+                std::memcpy(pixels + static_cast<size_t>(by + row) * surface->pitch + bx * 4, block + row * 16, static_cast<size_t>(w) * 4);
+            }
+        }
+    }
+    return surface;
+}
+
+std::string compressedTexturePath(const std::string& imagePath) {
+    size_t slash = imagePath.find_last_of("/\\");
+    size_t dot = imagePath.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return imagePath + ".vtc";
+    return imagePath.substr(0, dot) + ".vtc";
+}
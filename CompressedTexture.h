@@ -0,0 +1,63 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Формат сжатой текстуры (.vtc), которую готовит офлайн-утилита vntc. Блоки 4x4 пикселя
+// идут построчно и копируются в GPU без изменений; если устройство не читает формат,
+// они распаковываются на CPU в RGBA32.
+//
+//   VtcHeader
+//   uint8_t[dataSize] — ((width + 3) / 4) * ((height + 3) / 4) блоков
+
+constexpr char VTC_MAGIC[4] = {'V', 'T', 'C', '1'};
+constexpr uint32_t VTC_VERSION = 1;
+
+enum class TextureFormat : uint32_t {
+    BC1 = 0, // Непрозрачное RGB, 8 байт на блок
+    BC3 = 1  // RGBA: цвет как в BC1 и отдельный блок альфы, 16 байт на блок
+};
+
+// Бит формата в маске RenderModule::compressedFormats()
+constexpr uint32_t textureFormatBit(TextureFormat format) {
+    return 1u << static_cast<uint32_t>(format);
+}
+
+struct VtcHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;   // TextureFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t dataSize;
+};
+
+static_assert(sizeof(VtcHeader) == 24, "VtcHeader layout must be stable");
+
+// Текстура в блочном формате; цвета хранятся в sRGB, как и у несжатых изображений
+struct CompressedTexture {
+    TextureFormat format = TextureFormat::BC1;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> blocks;
+};
+
+size_t compressedBlockBytes(TextureFormat format);
+size_t compressedDataSize(TextureFormat format, int width, int height);
+
+// BC3 для изображений с прозрачностью, BC1 для остальных
+TextureFormat chooseTextureFormat(SDL_Surface* surface);
+// Сжимает поверхность в заданный формат. Возвращает false и текст ошибки в error.
+bool compressTexture(SDL_Surface* surface, TextureFormat format, CompressedTexture& texture, std::string& error);
+bool writeCompressedTexture(const CompressedTexture& texture, const std::string& outputPath, std::string& error);
+bool readCompressedTexture(const std::string& path, CompressedTexture& texture);
+// Распаковка на CPU для устройств без поддержки формата; возвращает RGBA32-поверхность
+SDL_Surface* decompressTexture(const CompressedTexture& texture);
+
+// Путь к сжатой текстуре рядом с исходной (bg.png -> bg.vtc)
+std::string compressedTexturePath(const std::string& imagePath);
+
+#endif // COMPRESSED_TEXTURE_H
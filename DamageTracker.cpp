@@ -0,0 +1,122 @@
+#include "DamageTracker.h"
+#include "VisualNovelEngine.h"
+#include <algorithm>
+
+namespace {
+
+uint64_t area(const SDL_Rect& rect) {
+    return static_cast<uint64_t>(rect.w) * static_cast<uint64_t>(rect.h);
+}
+
+} // namespace
+
+DamageTracker::DamageTracker(int width, int height) : window{0, 0, width, height} {}
+
+void DamageTracker::resize(int width, int height) {
+    window = {0, 0, width, height};
+    valid = false;
+}
+
+void DamageTracker::addRect(const SDL_Rect& rect) {
+    SDL_Rect clipped;
+    if (SDL_IntersectRect(&rect, &window, &clipped)) raw.push_back(clipped);
+}
+
+// Пересекающиеся области сливаются, пока их не останется MAX_RECTS; лишние объединяются парами
+// с наименьшим приростом площади
+void DamageTracker::mergeRects(std::vector<SDL_Rect>& rects) const {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t a = 0; a < rects.size() && !merged; a++) {
+            for (size_t b = a + 1; b < rects.size(); b++) {
+                if (!SDL_HasIntersection(&rects[a], &rects[b])) continue;
+                SDL_UnionRect(&rects[a], &rects[b], &rects[a]);
+                rects.erase(rects.begin() + b);
+                merged = true;
+                break;
+            }
+        }
+    }
+    while (rects.size() > MAX_RECTS) {
+        size_t bestA = 0, bestB = 1;
+        uint64_t bestGrowth = UINT64_MAX;
+        for (size_t a = 0; a < rects.size(); a++) {
+            for (size_t b = a + 1; b < rects.size(); b++) {
+                SDL_Rect unionRect;
+                SDL_UnionRect(&rects[a], &rects[b], &unionRect);
+                uint64_t growth = area(unionRect) - area(rects[a]) - area(rects[b]);
+                if (growth < bestGrowth) {
+                    bestGrowth = growth;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        SDL_UnionRect(&rects[bestA], &rects[bestB], &rects[bestA]);
+        rects.erase(rects.begin() + bestB);
+        // Объединённая область могла накрыть соседние
+        mergeRects(rects);
+    }
+}
+
+void DamageTracker::update(const std::vector<DisplayImage>& images, const std::vector<uint32_t>& versions, FrameDamage& damage) {
+    current.resize(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        const DisplayImage& img = images[i];
+        Entry& entry = current[i];
+        entry.texture = img.texture;
+        entry.version = img.texture < versions.size() ? versions[img.texture] : 0;
+        entry.rect = {img.x, img.y, img.w, img.h};
+        entry.visible = img.texture != INVALID_TEXTURE && img.w > 0 && img.h > 0;
+    }
+
+    damage.rects.clear();
+    damage.full = !valid;
+    if (valid) {
+        raw.clear();
+        size_t common = std::min(previous.size(), current.size());
+        for (size_t i = 0; i < common; i++) {
+            const Entry& before = previous[i];
+            const Entry& after = current[i];
+            if (before.texture == after.texture && before.version == after.version && before.visible == after.visible &&
+                SDL_RectEquals(&before.rect, &after.rect)) {
+                continue;
+            }
+            if (before.visible) addRect(before.rect);
+            if (after.visible) addRect(after.rect);
+        }
+        for (size_t i = common; i < previous.size(); i++) {
+            if (previous[i].visible) addRect(previous[i].rect);
+        }
+        for (size_t i = common; i < current.size(); i++) {
+            if (current[i].visible) addRect(current[i].rect);
+        }
+
+        if (raw.size() > MAX_RAW_RECTS) {
+            SDL_Rect bounds = raw[0];
+            for (const auto& rect : raw) SDL_UnionRect(&bounds, &rect, &bounds);
+            raw.assign(1, bounds);
+        }
+        mergeRects(raw);
+        uint64_t damaged = 0;
+        for (const auto& rect : raw) damaged += area(rect);
+        if (damaged >= static_cast<uint64_t>(area(window) * FULL_FRAME_RATIO)) {
+            damage.full = true;
+        } else {
+            damage.rects = raw;
+        }
+    }
+    valid = true;
+    previous.swap(current);
+
+    if (damage.full) {
+        counters.fullFrames++;
+        counters.damagedPixels += area(window);
+    } else if (damage.rects.empty()) {
+        counters.unchangedFrames++;
+    } else {
+        counters.partialFrames++;
+        for (const auto& rect : damage.rects) counters.damagedPixels += area(rect);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef DAMAGE_TRACKER_H
+#define DAMAGE_TRACKER_H
+
+#include "TextureRegistry.h"
+#include <SDL2/SDL.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct DisplayImage;
+
+// Области окна, изменившиеся с прошлого отрисованного кадра
+struct FrameDamage {
+    bool full = true;            // Перерисовать кадр целиком
+    std::vector<SDL_Rect> rects; // Иначе — только эти области в координатах окна; не пересекаются
+};
+
+struct DamageStats {
+    uint64_t fullFrames = 0;
+    uint64_t partialFrames = 0;
+    uint64_t unchangedFrames = 0; // Кадры без изменений: отрисовка и показ пропускаются
+    uint64_t damagedPixels = 0;   // Площадь перерисованных областей, включая полные кадры
+};
+
+// Сравнивает списки изображений соседних кадров. Изменившееся, появившееся или пропавшее изображение
+// повреждает свой старый и новый прямоугольник; близкие области объединяются, а кадр, где
+// повреждена большая часть окна, перерисовывается целиком
+class DamageTracker {
+private:
+    static const size_t MAX_RECTS = 8;         // Больше областей — больше проходов с ножницами в модуле
+    static const size_t MAX_RAW_RECTS = 64;    // Выше — сразу описанный прямоугольник
+    static constexpr double FULL_FRAME_RATIO = 0.5;
+
+    struct Entry {
+        TextureHandle texture = INVALID_TEXTURE;
+        uint32_t version = 0;
+        SDL_Rect rect = {0, 0, 0, 0};
+        bool visible = false;
+    };
+
+    SDL_Rect window;
+    std::vector<Entry> previous;
+    std::vector<Entry> current;
+    std::vector<SDL_Rect> raw;
+    bool valid = false;
+    DamageStats counters;
+
+    void addRect(const SDL_Rect& rect);
+    void mergeRects(std::vector<SDL_Rect>& rects) const;
+
+public:
+    explicit DamageTracker(int width = 1920, int height = 1080);
+
+    // Размер кадра модуля рендеринга; следующий кадр перерисовывается целиком
+    void resize(int width, int height);
+
+    // Следующий кадр перерисовывается целиком: окно показано заново или модуль догрузил текстуры
+    void invalidate() { valid = false; }
+    // versions — номер перезаписи для каждого TextureHandle (текст, загруженный под тем же ключом)
+    void update(const std::vector<DisplayImage>& images, const std::vector<uint32_t>& versions, FrameDamage& damage);
+
+    DamageStats stats() const { return counters; }
+};
+
+#endif // DAMAGE_TRACKER_H
@@ -0,0 +1,86 @@
+#include "LayerCache.h"
+#include <algorithm>
+
+namespace {
+
+size_t layerBytes(const SDL_Rect& bounds) {
+    return static_cast<size_t>(bounds.w) * bounds.h * 4;
+}
+
+} // namespace
+
+LayerCache::LayerCache(uint32_t maxLayers, uint32_t protectedFrames)
+    : maxLayers(maxLayers), protectedFrames(std::max(1u, protectedFrames)) {}
+
+void LayerCache::beginFrame(const std::vector<RenderLayer>& layers, std::vector<Draw>& draws, std::vector<uint32_t>& released) {
+    frame++;
+    draws.assign(layers.size(), Draw());
+    released.clear();
+
+    // Слой с тем же содержимым рисуется из уже собранной цели
+    for (size_t k = 0; k < layers.size(); k++) {
+        auto it = activeSlots.find(layers[k].key);
+        if (it == activeSlots.end()) continue;
+        Slot& slot = slots[it->second];
+        if (!SDL_RectEquals(&slot.bounds, &layers[k].bounds)) continue;
+        slot.lastUsedFrame = frame;
+        draws[k].slot = it->second;
+        counters.hits++;
+    }
+
+    // Слои прошлого кадра, которых больше нет: цель ждёт, пока её дочитают кадры в полёте
+    for (auto it = activeSlots.begin(); it != activeSlots.end();) {
+        Slot& slot = slots[it->second];
+        if (slot.lastUsedFrame == frame) {
+            ++it;
+            continue;
+        }
+        slot.active = false;
+        counters.invalidations++;
+        counters.cachedLayers--;
+        it = activeSlots.erase(it);
+    }
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        Slot& slot = slots[i];
+        if (!slot.allocated || slot.active || slot.lastUsedFrame + protectedFrames > frame) continue;
+        slot.allocated = false;
+        counters.cachedBytes -= layerBytes(slot.bounds);
+        released.push_back(i);
+    }
+
+    // Новым слоям — свободные ячейки; при нехватке слой рисуется без кэша
+    uint32_t freeSlot = 0;
+    for (size_t k = 0; k < layers.size(); k++) {
+        if (draws[k].slot != NO_SLOT) continue;
+        // Одинаковые участки в одном кадре делят цель, собранную для первого из них
+        auto it = activeSlots.find(layers[k].key);
+        if (it != activeSlots.end() && SDL_RectEquals(&slots[it->second].bounds, &layers[k].bounds)) {
+            draws[k].slot = it->second;
+            counters.hits++;
+            continue;
+        }
+        while (freeSlot < slots.size() && slots[freeSlot].allocated) freeSlot++;
+        if (freeSlot == slots.size()) {
+            if (slots.size() >= maxLayers) continue;
+            slots.emplace_back();
+        }
+        Slot& slot = slots[freeSlot];
+        slot.key = layers[k].key;
+        slot.bounds = layers[k].bounds;
+        slot.active = true;
+        slot.allocated = true;
+        slot.lastUsedFrame = frame;
+        activeSlots[slot.key] = freeSlot;
+        draws[k] = {freeSlot, true};
+        counters.builds++;
+        counters.cachedLayers++;
+        counters.cachedBytes += layerBytes(slot.bounds);
+    }
+}
+
+void LayerCache::clear() {
+    slots.clear();
+    activeSlots.clear();
+    frame = 0;
+    counters = LayerCacheStats();
+}
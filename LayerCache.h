@@ -0,0 +1,73 @@
+#ifndef LAYER_CACHE_H
+#define LAYER_CACHE_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Подряд идущие изображения кадра, которые не менялись с прошлых кадров (фон, спрайты персонажей).
+// Слои находит движок; модуль может собрать слой в текстуру один раз и рисовать её одним четырёхугольником
+struct RenderLayer {
+    size_t first = 0;  // Первое изображение слоя в кадре
+    size_t count = 0;
+    uint64_t key = 0;  // Хэш текстур, положений и размеров изображений слоя
+    SDL_Rect bounds = {0, 0, 0, 0}; // Объединение прямоугольников изображений
+};
+
+struct LayerCacheStats {
+    uint64_t hits = 0;          // Слои, нарисованные из готовой текстуры
+    uint64_t builds = 0;        // Сборки слоя в текстуру
+    uint64_t invalidations = 0; // Закэшированные слои, изображения которых изменились или исчезли с экрана
+    size_t cachedLayers = 0;
+    size_t cachedBytes = 0;     // Текстуры слоёв RGBA8, включая ещё не освобождённые
+};
+
+// Назначает слоям кадра ячейки — текстуры-цели модуля рендеринга. Как и TextureResidency,
+// не зависит от API: модуль создаёт цель при сборке и уничтожает её, когда ячейка освобождена.
+// Ячейка слоя, который пропал из кадра, освобождается через protectedFrames кадров, когда её
+// уже не читает ни один кадр в полёте.
+class LayerCache {
+public:
+    static const uint32_t NO_SLOT = UINT32_MAX;
+
+    struct Draw {
+        uint32_t slot = NO_SLOT; // NO_SLOT — ячеек не хватило, слой рисуется как обычно
+        bool build = false;      // Цель нужно собрать в этом кадре
+    };
+
+private:
+    struct Slot {
+        uint64_t key = 0;
+        SDL_Rect bounds = {0, 0, 0, 0};
+        bool active = false;    // Слой есть в последнем кадре
+        bool allocated = false; // Цель существует (активна или ждёт освобождения)
+        uint64_t lastUsedFrame = 0;
+    };
+
+    std::vector<Slot> slots;
+    std::unordered_map<uint64_t, uint32_t> activeSlots; // Ключ слоя -> ячейка
+    uint32_t maxLayers;
+    uint32_t protectedFrames;
+    uint64_t frame = 0;
+    LayerCacheStats counters;
+
+public:
+    explicit LayerCache(uint32_t maxLayers = 4, uint32_t protectedFrames = 1);
+
+    void setMaxLayers(uint32_t layers) { maxLayers = layers; }
+    void setProtectedFrames(uint32_t frames) { protectedFrames = frames < 1 ? 1 : frames; }
+    bool enabled() const { return maxLayers > 0; }
+
+    // draws[k] — ячейка слоя layers[k]; released — ячейки, цели которых модуль должен уничтожить
+    // до сборки новых. bounds слоёв модуль заранее обрезает по окну
+    void beginFrame(const std::vector<RenderLayer>& layers, std::vector<Draw>& draws, std::vector<uint32_t>& released);
+    const SDL_Rect& bounds(uint32_t slot) const { return slots[slot].bounds; }
+    uint32_t slotCount() const { return static_cast<uint32_t>(slots.size()); }
+    void clear();
+
+    LayerCacheStats stats() const { return counters; }
+};
+
+#endif // LAYER_CACHE_H
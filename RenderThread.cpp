@@ -0,0 +1,234 @@
+#include "RenderThread.h"
+#include "Trace.h"
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+RenderThread::RenderThread(std::unique_ptr<RenderModule> module) : module(std::move(module)) {}
+
+RenderThread::~RenderThread() {
+    cleanup();
+}
+
+bool RenderThread::init(const ProjectConfig& config) {
+    if (!module->init(config)) return false;
+    pendingUploads.store(module->hasPendingUploads(), std::memory_order_release);
+    module->detachThread();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        error = nullptr;
+    }
+    worker = std::thread(&RenderThread::workerLoop, this);
+    return true;
+}
+
+void RenderThread::stopWorker() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+    module->attachThread();
+}
+
+void RenderThread::cleanup() {
+    stopWorker();
+    if (module) module->cleanup();
+}
+
+// Вызовы модуля выполняются раньше кадра: опубликованный после них кадр может ссылаться на их текстуры
+void RenderThread::workerLoop() {
+    VNE_TRACE_THREAD_NAME("Render");
+    std::unique_lock<std::mutex> lock(mutex);
+    try {
+        module->attachThread();
+    } catch (...) {
+        error = std::current_exception();
+        stopping = true;
+    }
+    while (!stopping) {
+        if (!tasks.empty()) {
+            Task* task = tasks.front();
+            tasks.pop_front();
+            lock.unlock();
+            try {
+                (*task->call)();
+            } catch (...) {
+                task->error = std::current_exception();
+            }
+            pendingUploads.store(module->hasPendingUploads(), std::memory_order_release);
+            lock.lock();
+            task->finished = true;
+            done.notify_all();
+            continue;
+        }
+        if (!(readySlot.load(std::memory_order_acquire) & FRESH_BIT)) {
+            wake.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        std::exception_ptr frameError;
+        try {
+            if (takeFrame()) drawFrame(slots[readSlot]);
+        } catch (...) {
+            frameError = std::current_exception();
+        }
+        lock.lock();
+        if (frameError) {
+            error = frameError;
+            stopping = true;
+        }
+    }
+    // Ждущие вызовы получают ошибку, иначе их потоки не проснутся
+    for (Task* task : tasks) {
+        task->error = error ? error : std::make_exception_ptr(std::runtime_error("Render thread stopped"));
+        task->finished = true;
+    }
+    tasks.clear();
+    done.notify_all();
+    lock.unlock();
+    module->detachThread();
+}
+
+bool RenderThread::takeFrame() {
+    if (!(readySlot.load(std::memory_order_acquire) & FRESH_BIT)) return false;
+    // Только этот поток снимает FRESH_BIT, поэтому после проверки кадр никуда не денется
+    readSlot = readySlot.exchange(readSlot, std::memory_order_acq_rel) & ~FRESH_BIT;
+    return true;
+}
+
+void RenderThread::drawFrame(const FrameSnapshot& frame) {
+    VNE_TRACE_SCOPE("RenderThread::drawFrame");
+    auto begin = std::chrono::steady_clock::now();
+    // Области пропущенных кадров в damage этого не попали
+    module->setDamage(frame.sequence == renderedSequence + 1 ? frame.damage : FrameDamage());
+    if (frame.useLayers) {
+        module->renderLayers(frame.images, frame.layers);
+    } else {
+        module->render(frame.images);
+    }
+    renderedSequence = frame.sequence;
+    pendingUploads.store(module->hasPendingUploads(), std::memory_order_release);
+    double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.framesRendered++;
+    counters.lastFrameMs = frameMs;
+    counters.maxFrameMs = std::max(counters.maxFrameMs, frameMs);
+    counters.averageFrameMs += (frameMs - counters.averageFrameMs) / static_cast<double>(counters.framesRendered);
+}
+
+void RenderThread::publish() {
+    if (!worker.joinable()) {
+        // До init и после cleanup кадр рисуется сразу на вызывающем потоке
+        const FrameSnapshot& frame = slots[writeSlot];
+        module->setDamage(frame.damage);
+        if (frame.useLayers) module->renderLayers(frame.images, frame.layers);
+        else module->render(frame.images);
+        slots[writeSlot].damage = FrameDamage();
+        return;
+    }
+    slots[writeSlot].sequence = ++publishedSequence;
+    uint32_t previous = readySlot.exchange(writeSlot | FRESH_BIT, std::memory_order_acq_rel);
+    writeSlot = previous & ~FRESH_BIT;
+    slots[writeSlot].damage = FrameDamage();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error) std::rethrow_exception(error);
+        counters.framesSubmitted++;
+        if (previous & FRESH_BIT) counters.framesDropped++;
+    }
+    wake.notify_one();
+}
+
+void RenderThread::invoke(const std::function<void()>& call) const {
+    if (!worker.joinable()) {
+        call();
+        return;
+    }
+    Task task;
+    task.call = &call;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (stopping) {
+        if (error) std::rethrow_exception(error);
+        throw std::runtime_error("Render thread stopped");
+    }
+    tasks.push_back(&task);
+    counters.calls++;
+    wake.notify_one();
+    {
+        VNE_TRACE_SCOPE("RenderThread::invoke");
+        done.wait(lock, [&task] { return task.finished; });
+    }
+    if (task.error) std::rethrow_exception(task.error);
+}
+
+void RenderThread::render(const std::vector<DisplayImage>& images) {
+    FrameSnapshot& frame = slots[writeSlot];
+    frame.images = images;
+    frame.layers.clear();
+    frame.useLayers = false;
+    publish();
+}
+
+void RenderThread::renderLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) {
+    FrameSnapshot& frame = slots[writeSlot];
+    frame.images = images;
+    frame.layers = layers;
+    frame.useLayers = true;
+    publish();
+}
+
+TextureHandle RenderThread::loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps) {
+    TextureHandle handle = INVALID_TEXTURE;
+    invoke([&] { handle = module->loadImage(imageName, surface, mipmaps); });
+    return handle;
+}
+
+TextureHandle RenderThread::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
+    TextureHandle handle = INVALID_TEXTURE;
+    invoke([&] { handle = module->renderText(textKey, surface, x, y, w, h); });
+    return handle;
+}
+
+uint32_t RenderThread::compressedFormats() const {
+    uint32_t formats = 0;
+    invoke([&] { formats = module->compressedFormats(); });
+    return formats;
+}
+
+TextureHandle RenderThread::loadCompressedImage(const std::string& imageName, const CompressedTexture& texture) {
+    TextureHandle handle = INVALID_TEXTURE;
+    invoke([&] { handle = module->loadCompressedImage(imageName, texture); });
+    return handle;
+}
+
+void RenderThread::setTextureSource(TextureSource source) {
+    invoke([&] { module->setTextureSource(std::move(source)); });
+}
+
+ResidencyStats RenderThread::residencyStats() const {
+    ResidencyStats result;
+    invoke([&] { result = module->residencyStats(); });
+    return result;
+}
+
+LayerCacheStats RenderThread::layerCacheStats() const {
+    LayerCacheStats result;
+    invoke([&] { result = module->layerCacheStats(); });
+    return result;
+}
+
+SDL_Point RenderThread::outputSize() const {
+    SDL_Point result;
+    invoke([&] { result = module->outputSize(); });
+    return result;
+}
+
+RenderThreadStats RenderThread::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
@@ -0,0 +1,94 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include "VisualNovelEngine.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <cstdint>
+
+// Неизменяемый после публикации кадр: всё, что нужно модулю для отрисовки
+struct FrameSnapshot {
+    std::vector<DisplayImage> images;
+    std::vector<RenderLayer> layers;
+    bool useLayers = false;
+    FrameDamage damage;
+    uint64_t sequence = 0; // Номер публикации; пропуск номера — кадр был заменён, не дойдя до экрана
+};
+
+// Модуль рендеринга на отдельном потоке. Движок видит обычный RenderModule: render и renderLayers
+// публикуют снимок кадра и сразу возвращаются, остальные вызовы выполняются на потоке рендеринга
+// синхронно, поэтому модулю не нужно быть потокобезопасным. Снимки лежат в тройном буфере: поток
+// сценария пишет в свой, поток рендеринга читает свой, а готовый кадр передаётся обменом индекса
+// без блокировок. Показывается только самый свежий кадр
+class RenderThread : public RenderModule {
+private:
+    static const uint32_t FRESH_BIT = 0x4; // В readySlot лежит кадр, который ещё не забран
+
+    std::unique_ptr<RenderModule> module;
+
+    FrameSnapshot slots[3];
+    uint32_t writeSlot = 0;             // Только поток сценария
+    uint32_t readSlot = 1;              // Только поток рендеринга
+    std::atomic<uint32_t> readySlot{2}; // Индекс | FRESH_BIT
+    uint64_t publishedSequence = 0;
+    uint64_t renderedSequence = 0;
+    std::atomic<bool> pendingUploads{false};
+
+    // Вызов модуля, ожидающий выполнения на потоке рендеринга; живёт на стеке вызывающего
+    struct Task {
+        const std::function<void()>* call = nullptr;
+        std::exception_ptr error;
+        bool finished = false;
+    };
+
+    std::thread worker;
+    mutable std::mutex mutex; // Очередь вызовов, пробуждение потока и счётчики
+    mutable std::condition_variable wake;
+    mutable std::condition_variable done;
+    mutable std::deque<Task*> tasks;
+    bool stopping = false;
+    std::exception_ptr error; // Исключение при отрисовке; пробрасывается в поток сценария
+    mutable RenderThreadStats counters;
+
+    void workerLoop();
+    bool takeFrame();
+    void drawFrame(const FrameSnapshot& frame);
+    void publish();
+    void invoke(const std::function<void()>& call) const;
+    void stopWorker();
+
+public:
+    explicit RenderThread(std::unique_ptr<RenderModule> module);
+    ~RenderThread() override;
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Модуль инициализируется на вызывающем потоке (там создаётся окно), затем переходит на поток рендеринга
+    bool init(const ProjectConfig& config) override;
+    void render(const std::vector<DisplayImage>& images) override;
+    void renderLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) override;
+    void cleanup() override;
+    TextureHandle loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps = false) override;
+    TextureHandle renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) override;
+    uint32_t compressedFormats() const override;
+    TextureHandle loadCompressedImage(const std::string& imageName, const CompressedTexture& texture) override;
+    // Состояние после последнего кадра или вызова на потоке рендеринга
+    bool hasPendingUploads() const override { return pendingUploads.load(std::memory_order_acquire); }
+    // Источник вызывается модулем на потоке рендеринга
+    void setTextureSource(TextureSource source) override;
+    ResidencyStats residencyStats() const override;
+    LayerCacheStats layerCacheStats() const override;
+    SDL_Point outputSize() const override;
+    // Относится к следующему render или renderLayers
+    void setDamage(const FrameDamage& frameDamage) override { slots[writeSlot].damage = frameDamage; }
+
+    RenderThreadStats stats() const;
+};
+
+#endif // RENDER_THREAD_H
@@ -0,0 +1,184 @@
+#include "ScriptSource.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <fstream>
+#include <cstring>
+#include <iostream>
+#include <cctype>
+
+namespace {
+
+struct AssetExtension {
+    const char* extension;
+    AssetKind kind;
+};
+
+const AssetExtension assetExtensions[] = {
+    {".png", AssetKind::Image},
+    {".jpg", AssetKind::Image},
+    {".jpeg", AssetKind::Image},
+    {".bmp", AssetKind::Image},
+    {".webp", AssetKind::Image},
+    {".wav", AssetKind::Audio},
+    {".ogg", AssetKind::Audio},
+    {".mp3", AssetKind::Audio},
+    {".mp4", AssetKind::Video},
+    {".webm", AssetKind::Video}
+};
+
+bool isTokenSeparator(char c) {
+    return std::isspace(static_cast<unsigned char>(c)) || c == '"' || c == '\'' || c == ',' ||
+           c == '(' || c == ')' || c == '[' || c == ']' || c == '=' || c == ';';
+}
+
+bool endsWithNoCase(std::string_view token, std::string_view suffix) {
+    if (token.size() <= suffix.size()) return false;
+    std::string_view tail = token.substr(token.size() - suffix.size());
+    for (size_t i = 0; i < suffix.size(); i++) {
+        if (std::tolower(static_cast<unsigned char>(tail[i])) != suffix[i]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void findAssetReferences(std::string_view line, std::vector<AssetReference>& out) {
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && isTokenSeparator(line[pos])) pos++;
+        size_t begin = pos;
+        while (pos < line.size() && !isTokenSeparator(line[pos])) pos++;
+        if (pos == begin) continue;
+
+        std::string_view token = line.substr(begin, pos - begin);
+        for (const auto& ext : assetExtensions) {
+            if (endsWithNoCase(token, ext.extension)) {
+                out.push_back({token, ext.kind});
+                break;
+            }
+        }
+    }
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    fileSize = static_cast<size_t>(size.QuadPart);
+    if (fileSize == 0) return true; // Пустой файл отобразить нельзя, но это корректный сценарий
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    mappingHandle = mapping;
+    fileData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!fileData) {
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    fileSize = static_cast<size_t>(st.st_size);
+    if (fileSize == 0) {
+        ::close(fd);
+        return true;
+    }
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // Отображение остаётся действительным после закрытия дескриптора
+    if (mapped == MAP_FAILED) {
+        fileSize = 0;
+        return false;
+    }
+    madvise(mapped, fileSize, MADV_SEQUENTIAL);
+    fileData = static_cast<const char*>(mapped);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (fileData) UnmapViewOfFile(fileData);
+    if (mappingHandle) CloseHandle((HANDLE)mappingHandle);
+    if (fileHandle) CloseHandle((HANDLE)fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (fileData) munmap(const_cast<char*>(fileData), fileSize);
+#endif
+    fileData = nullptr;
+    fileSize = 0;
+}
+
+bool MappedScriptSource::open(const std::string& path) {
+    lineStarts.clear();
+    if (!file.open(path)) return false;
+
+    const char* data = file.data();
+    size_t size = file.size();
+    // Смещения хранятся в 32 битах, чтобы индекс занимал 4 байта на строку
+    if (size >= UINT32_MAX) {
+        std::cerr << "Script file is too large for line index: " << path << "\n";
+        file.close();
+        return false;
+    }
+
+    // Тот же разбор, что и у std::getline: завершающий '\n' не порождает пустую строку
+    size_t pos = 0;
+    while (pos < size) {
+        lineStarts.push_back(static_cast<uint32_t>(pos));
+        const void* newline = memchr(data + pos, '\n', size - pos);
+        if (!newline) {
+            pos = size + 1; // Последняя строка без перевода строки
+            break;
+        }
+        pos = static_cast<size_t>(static_cast<const char*>(newline) - data) + 1;
+    }
+    lineStarts.push_back(static_cast<uint32_t>(pos));
+    lineStarts.shrink_to_fit();
+    return true;
+}
+
+size_t MappedScriptSource::lineCount() const {
+    return lineStarts.empty() ? 0 : lineStarts.size() - 1;
+}
+
+std::string_view MappedScriptSource::line(size_t index) const {
+    uint32_t begin = lineStarts[index];
+    uint32_t end = lineStarts[index + 1] - 1;
+    return std::string_view(file.data() + begin, end - begin);
+}
+
+bool VectorScriptSource::open(const std::string& path) {
+    std::ifstream scriptFile(path);
+    if (!scriptFile.is_open()) return false;
+    scriptLines.clear();
+    std::string line;
+    while (std::getline(scriptFile, line)) scriptLines.push_back(line);
+    scriptFile.close();
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef SCRIPT_SOURCE_H
+#define SCRIPT_SOURCE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+enum class AssetKind : uint8_t {
+    Image = 0,
+    Audio = 1,
+    Video = 2
+};
+
+// Ссылка на ресурс внутри строки сценария (путь указывает в память источника)
+struct AssetReference {
+    std::string_view path;
+    AssetKind kind;
+};
+
+// Находит в строке токены с расширениями ресурсов (.png, .jpg, .wav, .mp3, .mp4 и т.д.)
+void findAssetReferences(std::string_view line, std::vector<AssetReference>& out);
+
+// Источник строк сценария. Движок обращается к строкам только по индексу,
+// поэтому переход на произвольную строку стоит O(1) для любой реализации.
+class ScriptSource {
+public:
+    virtual ~ScriptSource() = default;
+    virtual size_t lineCount() const = 0;
+    virtual std::string_view line(size_t index) const = 0;
+
+    // По умолчанию ресурсы ищутся разбором строки; скомпилированный сценарий отдаёт готовую таблицу
+    virtual void assetReferences(size_t index, std::vector<AssetReference>& out) const {
+        findAssetReferences(line(index), out);
+    }
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+private:
+    const char* fileData = nullptr;
+    size_t fileSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    const char* data() const { return fileData; }
+    size_t size() const { return fileSize; }
+};
+
+// Сценарий в отображённом файле с индексом начала строк.
+// Индекс строится за один проход, строки отдаются как std::string_view без копирования.
+class MappedScriptSource : public ScriptSource {
+private:
+    MappedFile file;
+    std::vector<uint32_t> lineStarts; // Последний элемент — граница за концом последней строки
+
+public:
+    bool open(const std::string& path);
+    size_t lineCount() const override;
+    std::string_view line(size_t index) const override;
+};
+
+// Старый путь: каждая строка хранится в отдельном std::string (оставлен для сравнения)
+class VectorScriptSource : public ScriptSource {
+private:
+    std::vector<std::string> scriptLines;
+
+public:
+    bool open(const std::string& path);
+    size_t lineCount() const override { return scriptLines.size(); }
+    std::string_view line(size_t index) const override { return scriptLines[index]; }
+};
+
+#endif // SCRIPT_SOURCE_H
@@ -0,0 +1,285 @@
+#include "TextRenderer.h"
+#include "VisualNovelEngine.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Некорректные последовательности заменяются на U+FFFD
+void decodeUtf8(const std::string& text, std::vector<uint32_t>& codepoints) {
+    codepoints.clear();
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t size = text.size();
+    for (size_t i = 0; i < size;) {
+        unsigned char lead = bytes[i];
+        uint32_t codepoint;
+        size_t length;
+        if (lead < 0x80) {
+            codepoint = lead;
+            length = 1;
+        } else if ((lead & 0xE0) == 0xC0) {
+            codepoint = lead & 0x1F;
+            length = 2;
+        } else if ((lead & 0xF0) == 0xE0) {
+            codepoint = lead & 0x0F;
+            length = 3;
+        } else if ((lead & 0xF8) == 0xF0) {
+            codepoint = lead & 0x07;
+            length = 4;
+        } else {
+            codepoints.push_back(REPLACEMENT_CHARACTER);
+            i++;
+            continue;
+        }
+        if (i + length > size) {
+            codepoints.push_back(REPLACEMENT_CHARACTER);
+            break;
+        }
+        bool valid = true;
+        for (size_t k = 1; k < length; k++) {
+            if ((bytes[i + k] & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            codepoint = (codepoint << 6) | (bytes[i + k] & 0x3F);
+        }
+        if (!valid || codepoint > 0x10FFFF) {
+            codepoints.push_back(REPLACEMENT_CHARACTER);
+            i++;
+            continue;
+        }
+        codepoints.push_back(codepoint);
+        i += length;
+    }
+}
+
+} // namespace
+
+TextRenderer::TextRenderer(RenderModule& renderModule) : renderModule(renderModule) {
+    initialized = TTF_Init() == 0;
+    if (!initialized) {
+        std::cerr << "Failed to initialize SDL_ttf: " << TTF_GetError() << "\n";
+    }
+}
+
+TextRenderer::~TextRenderer() {
+    for (auto& font : fonts) {
+        if (font.font) TTF_CloseFont(font.font);
+    }
+    if (initialized) TTF_Quit();
+}
+
+FontHandle TextRenderer::loadFont(const std::string& path, int size) {
+    if (!initialized) return INVALID_FONT;
+    if (fonts.size() >= MAX_FONTS) {
+        std::cerr << "Too many fonts, cannot load " << path << "\n";
+        return INVALID_FONT;
+    }
+    std::lock_guard<std::mutex> lock(fontMutex);
+    TTF_Font* font = TTF_OpenFont(path.c_str(), size);
+    if (!font) {
+        std::cerr << "Failed to load font " << path << ": " << TTF_GetError() << "\n";
+        return INVALID_FONT;
+    }
+    Font entry;
+    entry.font = font;
+    entry.lineSkip = TTF_FontLineSkip(font);
+    fonts.push_back(entry);
+    return static_cast<FontHandle>(fonts.size() - 1);
+}
+
+// Цвет — старшие 32 бита, шрифт — 11 бит, код символа — младшие 21 бит
+uint64_t TextRenderer::glyphKey(FontHandle font, uint32_t codepoint, SDL_Color color) {
+    uint64_t rgba = (static_cast<uint64_t>(color.r) << 24) | (static_cast<uint64_t>(color.g) << 16) |
+                    (static_cast<uint64_t>(color.b) << 8) | color.a;
+    return (rgba << 32) | (static_cast<uint64_t>(font) << 21) | (codepoint & 0x1FFFFF);
+}
+
+std::string TextRenderer::glyphName(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "glyph:%016llx", static_cast<unsigned long long>(key));
+    return name;
+}
+
+SDL_Surface* TextRenderer::rasterize(uint64_t key, int& offsetX, int& offsetY) const {
+    FontHandle font = static_cast<FontHandle>((key >> 21) & (MAX_FONTS - 1));
+    uint32_t codepoint = static_cast<uint32_t>(key & 0x1FFFFF);
+    uint32_t rgba = static_cast<uint32_t>(key >> 32);
+    SDL_Color color = {static_cast<Uint8>(rgba >> 24), static_cast<Uint8>(rgba >> 16), static_cast<Uint8>(rgba >> 8), static_cast<Uint8>(rgba)};
+    if (font >= fonts.size()) return nullptr;
+
+    SDL_Surface* rendered = TTF_RenderGlyph32_Blended(fonts[font].font, codepoint, color);
+    if (!rendered) return nullptr;
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(rendered);
+    if (!converted) return nullptr;
+
+    // Прозрачные поля ячейки отрезаются, чтобы не занимать место в атласе
+    int left = converted->w, top = converted->h, right = -1, bottom = -1;
+    for (int y = 0; y < converted->h; y++) {
+        const uint8_t* row = static_cast<const uint8_t*>(converted->pixels) + static_cast<size_t>(y) * converted->pitch;
+        for (int x = 0; x < converted->w; x++) {
+            if (row[x * 4 + 3] == 0) continue;
+            left = std::min(left, x);
+            right = std::max(right, x);
+            top = std::min(top, y);
+            bottom = y;
+        }
+    }
+    SDL_Surface* cropped = nullptr;
+    if (right >= left) {
+        int w = right - left + 1;
+        int h = bottom - top + 1;
+        cropped = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+        if (cropped) {
+            for (int y = 0; y < h; y++) {
+                memcpy(static_cast<uint8_t*>(cropped->pixels) + static_cast<size_t>(y) * cropped->pitch,
+                       static_cast<const uint8_t*>(converted->pixels) + static_cast<size_t>(top + y) * converted->pitch + left * 4,
+                       static_cast<size_t>(w) * 4);
+            }
+            offsetX = left;
+            offsetY = top;
+        }
+    }
+    SDL_FreeSurface(converted);
+    return cropped;
+}
+
+const TextRenderer::Glyph& TextRenderer::glyph(FontHandle font, uint32_t codepoint, SDL_Color color) {
+    uint64_t key = glyphKey(font, codepoint, color);
+    auto [it, inserted] = glyphs.try_emplace(key);
+    Glyph& entry = it->second;
+    if (!inserted) return entry;
+
+    SDL_Surface* surface;
+    {
+        std::lock_guard<std::mutex> lock(fontMutex);
+        int minX, maxX, minY, maxY, advance;
+        if (TTF_GlyphMetrics32(fonts[font].font, codepoint, &minX, &maxX, &minY, &maxY, &advance) == 0) {
+            entry.advance = advance;
+        }
+        surface = rasterize(key, entry.offsetX, entry.offsetY);
+    }
+    if (surface) {
+        // Загрузка идёт без блокировки: с потоком рендеринга она ждёт его, а он может перерисовывать глифы
+        std::string name = glyphName(key);
+        entry.texture = renderModule.loadImage(name, surface);
+        entry.w = surface->w;
+        entry.h = surface->h;
+        {
+            std::lock_guard<std::mutex> lock(fontMutex);
+            glyphNames[name] = key;
+        }
+        SDL_FreeSurface(surface);
+        counters.glyphsRasterized++;
+    }
+    return entry;
+}
+
+int TextRenderer::kerning(FontHandle font, uint32_t previous, uint32_t codepoint) const {
+    if (previous == 0) return 0;
+    std::lock_guard<std::mutex> lock(fontMutex);
+    return TTF_GetFontKerningSizeGlyphs32(fonts[font].font, previous, codepoint);
+}
+
+void TextRenderer::buildLayout(FontHandle font, SDL_Color color, int wrapWidth, TextLayout& layout) {
+    // Жадный перенос по последнему пробелу; слово длиннее строки переносится по символам
+    std::vector<std::pair<size_t, size_t>> lines;
+    size_t lineBegin = 0;
+    size_t lastSpace = SIZE_MAX;
+    int x = 0;
+    uint32_t previous = 0;
+    for (size_t i = 0; i < codepoints.size(); i++) {
+        uint32_t codepoint = codepoints[i];
+        if (codepoint == '\n') {
+            lines.push_back({lineBegin, i});
+            lineBegin = i + 1;
+            lastSpace = SIZE_MAX;
+            x = 0;
+            previous = 0;
+            continue;
+        }
+        int advance = kerning(font, previous, codepoint) + glyph(font, codepoint, color).advance;
+        if (wrapWidth > 0 && codepoint != ' ' && x + advance > wrapWidth && i > lineBegin) {
+            if (lastSpace != SIZE_MAX) {
+                // Слово после пробела измеряется заново уже на новой строке
+                lines.push_back({lineBegin, lastSpace});
+                lineBegin = lastSpace + 1;
+                i = lastSpace;
+            } else {
+                lines.push_back({lineBegin, i});
+                lineBegin = i;
+                i--;
+            }
+            lastSpace = SIZE_MAX;
+            x = 0;
+            previous = 0;
+            continue;
+        }
+        if (codepoint == ' ') lastSpace = i;
+        x += advance;
+        previous = codepoint;
+    }
+    lines.push_back({lineBegin, codepoints.size()});
+
+    int lineSkip = fonts[font].lineSkip;
+    for (size_t line = 0; line < lines.size(); line++) {
+        int penX = 0;
+        int top = static_cast<int>(line) * lineSkip;
+        previous = 0;
+        for (size_t i = lines[line].first; i < lines[line].second; i++) {
+            uint32_t codepoint = codepoints[i];
+            penX += kerning(font, previous, codepoint);
+            const Glyph& entry = glyph(font, codepoint, color);
+            if (entry.texture != INVALID_TEXTURE) {
+                layout.quads.push_back({entry.texture, penX + entry.offsetX, top + entry.offsetY, entry.w, entry.h, static_cast<uint32_t>(i)});
+            }
+            penX += entry.advance;
+            previous = codepoint;
+        }
+        layout.width = std::max(layout.width, penX);
+    }
+    layout.lines = static_cast<uint32_t>(lines.size());
+    layout.height = static_cast<int>(lines.size()) * lineSkip;
+    layout.characters = static_cast<uint32_t>(codepoints.size());
+}
+
+std::shared_ptr<const TextLayout> TextRenderer::layout(FontHandle font, const std::string& text, int wrapWidth, SDL_Color color) {
+    VNE_TRACE_SCOPE("TextRenderer::layout");
+    if (font >= fonts.size()) return nullptr;
+
+    layoutKey.clear();
+    layoutKey.append(reinterpret_cast<const char*>(&font), sizeof(font));
+    layoutKey.append(reinterpret_cast<const char*>(&wrapWidth), sizeof(wrapWidth));
+    layoutKey.append(reinterpret_cast<const char*>(&color), sizeof(color));
+    layoutKey.append(text);
+    auto cached = layouts.find(layoutKey);
+    if (cached != layouts.end()) {
+        counters.layoutHits++;
+        return cached->second;
+    }
+    counters.layoutMisses++;
+
+    decodeUtf8(text, codepoints);
+    auto result = std::make_shared<TextLayout>();
+    buildLayout(font, color, wrapWidth, *result);
+    // Кэш сбрасывается целиком: раскладка пересчитывается быстро, а глифы остаются загруженными
+    if (layouts.size() >= MAX_CACHED_LAYOUTS) layouts.clear();
+    layouts.emplace(layoutKey, result);
+    return result;
+}
+
+DecodedImage TextRenderer::reload(const std::string& name) const {
+    DecodedImage image;
+    std::lock_guard<std::mutex> lock(fontMutex);
+    auto it = glyphNames.find(name);
+    if (it == glyphNames.end()) return image;
+    int offsetX = 0, offsetY = 0;
+    image.surface = rasterize(it->second, offsetX, offsetY);
+    return image;
+}
@@ -0,0 +1,102 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include "TextureRegistry.h"
+#include "AssetPrefetcher.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+class RenderModule;
+
+using FontHandle = uint32_t;
+constexpr FontHandle INVALID_FONT = UINT32_MAX;
+
+// Глиф в раскладке; координаты относительно левого верхнего угла текста
+struct GlyphQuad {
+    TextureHandle texture;
+    int x, y, w, h;
+    uint32_t index; // Номер символа в строке: при постепенном появлении рисуются глифы с index < revealed
+};
+
+struct TextLayout {
+    std::vector<GlyphQuad> quads;
+    int width = 0;
+    int height = 0;
+    uint32_t characters = 0; // Символов в строке, включая пробелы и переводы строк
+    uint32_t lines = 0;
+};
+
+struct TextStats {
+    uint64_t glyphsRasterized = 0; // Растеризовано и загружено глифов (каждый — один раз)
+    uint64_t layoutHits = 0;
+    uint64_t layoutMisses = 0;
+};
+
+// Текст из кэша глифов. Каждый глиф растеризуется один раз и загружается в модуль рендеринга
+// как обычное мелкое изображение, поэтому попадает в атлас и рисуется в общей пачке спрайтов.
+// Раскладка (ширины, кернинг, перенос по словам) кэшируется по строке и стилю; показ текста
+// по буквам — это отрисовка большего числа готовых глифов без загрузок.
+class TextRenderer {
+private:
+    // В ключе глифа коду символа отводится 21 бит, шрифту — 11
+    static const uint32_t MAX_FONTS = 1u << 11;
+    static const size_t MAX_CACHED_LAYOUTS = 512;
+
+    struct Font {
+        TTF_Font* font = nullptr;
+        int lineSkip = 0;
+    };
+
+    struct Glyph {
+        TextureHandle texture = INVALID_TEXTURE; // INVALID_TEXTURE — глиф без пикселей (пробел)
+        int offsetX = 0; // Положение непрозрачной части относительно пера и верха строки
+        int offsetY = 0;
+        int w = 0;
+        int h = 0;
+        int advance = 0;
+    };
+
+    RenderModule& renderModule;
+    bool initialized = false;
+    std::vector<Font> fonts;
+    std::unordered_map<uint64_t, Glyph> glyphs;
+    std::unordered_map<std::string, uint64_t> glyphNames; // Имя текстуры -> ключ глифа, для повторной растеризации
+    // Шрифты SDL_ttf и glyphNames: reload вызывается модулем рендеринга, который может работать на своём потоке
+    mutable std::mutex fontMutex;
+    std::unordered_map<std::string, std::shared_ptr<const TextLayout>> layouts;
+    std::string layoutKey;
+    std::vector<uint32_t> codepoints;
+    TextStats counters;
+
+    static uint64_t glyphKey(FontHandle font, uint32_t codepoint, SDL_Color color);
+    static std::string glyphName(uint64_t key);
+    SDL_Surface* rasterize(uint64_t key, int& offsetX, int& offsetY) const;
+    const Glyph& glyph(FontHandle font, uint32_t codepoint, SDL_Color color);
+    int kerning(FontHandle font, uint32_t previous, uint32_t codepoint) const;
+    void buildLayout(FontHandle font, SDL_Color color, int wrapWidth, TextLayout& layout);
+
+public:
+    explicit TextRenderer(RenderModule& renderModule);
+    ~TextRenderer();
+    TextRenderer(const TextRenderer&) = delete;
+    TextRenderer& operator=(const TextRenderer&) = delete;
+
+    // INVALID_FONT, если файл не открылся
+    FontHandle loadFont(const std::string& path, int size);
+    // Раскладка строки UTF-8; wrapWidth — ширина переноса по словам в пикселях (0 — только по '\n')
+    std::shared_ptr<const TextLayout> layout(FontHandle font, const std::string& text, int wrapWidth, SDL_Color color);
+
+    // Глифы загружаются под именами "glyph:..."; вытесненный из видеопамяти глиф растеризуется снова
+    static bool isGlyphName(const std::string& name) { return name.compare(0, 6, "glyph:") == 0; }
+    DecodedImage reload(const std::string& name) const;
+
+    TextStats stats() const { return counters; }
+};
+
+#endif // TEXT_RENDERER_H
@@ -0,0 +1,247 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+TextureAtlas::TextureAtlas(int pageSize, int maxEntrySize, size_t maxPages)
+    : pageSize(pageSize), maxEntrySize(std::min(maxEntrySize, pageSize - 2 * PADDING)), maxPages(maxPages) {}
+
+bool TextureAtlas::accepts(int w, int h) const {
+    return maxPages > 0 && w > 0 && h > 0 && w <= maxEntrySize && h <= maxEntrySize;
+}
+
+void TextureAtlas::addPage() {
+    Page page;
+    page.pixels.assign(static_cast<size_t>(pageSize) * pageSize, 0);
+    page.skyline.push_back({0, 0, pageSize});
+    pages.push_back(std::move(page));
+}
+
+// Нижний левый угол: из всех отрезков горизонта выбирается тот, где прямоугольник встанет ниже всего
+bool TextureAtlas::findPosition(const std::vector<SkylineNode>& skyline, int pageSize, int w, int h, int& outX, int& outY, size_t& outNode) {
+    int bestBottom = INT32_MAX;
+    int bestWidth = INT32_MAX;
+    for (size_t i = 0; i < skyline.size(); i++) {
+        int x = skyline[i].x;
+        if (x + w > pageSize) break;
+        int y = skyline[i].y;
+        int widthLeft = w;
+        size_t j = i;
+        bool fits = true;
+        while (widthLeft > 0) {
+            y = std::max(y, skyline[j].y);
+            if (y + h > pageSize) {
+                fits = false;
+                break;
+            }
+            widthLeft -= skyline[j].width;
+            j++;
+        }
+        if (!fits) continue;
+        if (y + h < bestBottom || (y + h == bestBottom && skyline[i].width < bestWidth)) {
+            bestBottom = y + h;
+            bestWidth = skyline[i].width;
+            outX = x;
+            outY = y;
+            outNode = i;
+        }
+    }
+    return bestBottom != INT32_MAX;
+}
+
+void TextureAtlas::placeRect(std::vector<SkylineNode>& skyline, size_t node, int x, int y, int w, int h) {
+    skyline.insert(skyline.begin() + node, {x, y + h, w});
+    // Отрезки, накрытые новым прямоугольником, укорачиваются или удаляются
+    for (size_t i = node + 1; i < skyline.size();) {
+        const SkylineNode& previous = skyline[i - 1];
+        SkylineNode& current = skyline[i];
+        int overlap = previous.x + previous.width - current.x;
+        if (overlap <= 0) break;
+        current.x += overlap;
+        current.width -= overlap;
+        if (current.width > 0) break;
+        skyline.erase(skyline.begin() + i);
+    }
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+}
+
+bool TextureAtlas::allocate(uint32_t pageIndex, int w, int h, int& x, int& y) {
+    Page& page = pages[pageIndex];
+    size_t node;
+    if (!findPosition(page.skyline, pageSize, w, h, x, y, node)) return false;
+    placeRect(page.skyline, node, x, y, w, h);
+    page.allocatedArea += static_cast<size_t>(w) * h;
+    return true;
+}
+
+void TextureAtlas::markDirty(Page& page, int x, int y, int w, int h) {
+    if (page.dirty.w == 0 || page.dirty.h == 0) {
+        page.dirty = {x, y, w, h};
+        return;
+    }
+    int x0 = std::min(page.dirty.x, x);
+    int y0 = std::min(page.dirty.y, y);
+    int x1 = std::max(page.dirty.x + page.dirty.w, x + w);
+    int y1 = std::max(page.dirty.y + page.dirty.h, y + h);
+    page.dirty = {x0, y0, x1 - x0, y1 - y0};
+}
+
+void TextureAtlas::updateUv(AtlasRegion& region) const {
+    float scale = 1.0f / static_cast<float>(pageSize);
+    region.u0 = region.x * scale;
+    region.v0 = region.y * scale;
+    region.u1 = (region.x + region.w) * scale;
+    region.v1 = (region.y + region.h) * scale;
+}
+
+void TextureAtlas::blit(Page& page, const uint32_t* src, int srcPitch, const AtlasRegion& region) {
+    uint32_t* dst = page.pixels.data();
+    for (int row = 0; row < region.h; row++) {
+        uint32_t* out = dst + static_cast<size_t>(region.y + row) * pageSize + region.x;
+        std::memcpy(out, src + static_cast<size_t>(row) * srcPitch, static_cast<size_t>(region.w) * 4);
+        out[-1] = out[0];
+        out[region.w] = out[region.w - 1];
+    }
+    size_t rowBytes = static_cast<size_t>(region.w + 2 * PADDING) * 4;
+    uint32_t* first = dst + static_cast<size_t>(region.y) * pageSize + region.x - PADDING;
+    uint32_t* last = dst + static_cast<size_t>(region.y + region.h - 1) * pageSize + region.x - PADDING;
+    std::memcpy(first - pageSize, first, rowBytes);
+    std::memcpy(last + pageSize, last, rowBytes);
+    markDirty(page, region.x - PADDING, region.y - PADDING, region.w + 2 * PADDING, region.h + 2 * PADDING);
+}
+
+bool TextureAtlas::repack(uint32_t pageIndex) {
+    Page& page = pages[pageIndex];
+    std::vector<TextureHandle> order = page.entries;
+    std::sort(order.begin(), order.end(), [this](TextureHandle a, TextureHandle b) {
+        return regions[a].h > regions[b].h;
+    });
+
+    // Новая раскладка считается целиком до изменения страницы, чтобы при неудаче ничего не потерять
+    std::vector<SkylineNode> skyline = {{0, 0, pageSize}};
+    std::vector<SDL_Point> positions;
+    positions.reserve(order.size());
+    for (TextureHandle handle : order) {
+        const AtlasRegion& region = regions[handle];
+        int w = region.w + 2 * PADDING;
+        int h = region.h + 2 * PADDING;
+        int x, y;
+        size_t node;
+        if (!findPosition(skyline, pageSize, w, h, x, y, node)) return false;
+        placeRect(skyline, node, x, y, w, h);
+        positions.push_back({x, y});
+    }
+
+    std::vector<uint32_t> previous = page.pixels;
+    for (size_t i = 0; i < order.size(); i++) {
+        AtlasRegion& region = regions[order[i]];
+        size_t rowBytes = static_cast<size_t>(region.w + 2 * PADDING) * 4;
+        for (int row = 0; row < region.h + 2 * PADDING; row++) {
+            const uint32_t* from = previous.data() + static_cast<size_t>(region.y - PADDING + row) * pageSize + region.x - PADDING;
+            uint32_t* to = page.pixels.data() + static_cast<size_t>(positions[i].y + row) * pageSize + positions[i].x;
+            std::memcpy(to, from, rowBytes);
+        }
+        region.x = positions[i].x + PADDING;
+        region.y = positions[i].y + PADDING;
+        updateUv(region);
+    }
+    page.skyline = std::move(skyline);
+    page.allocatedArea = page.liveArea;
+    page.dirty = {0, 0, pageSize, pageSize};
+    return true;
+}
+
+bool TextureAtlas::insert(TextureHandle handle, SDL_Surface* surface) {
+    // Прежняя область освобождается и при отказе: иначе перерисованный под тем же ключом текст,
+    // переросший атлас, продолжал бы показываться из старой области
+    remove(handle);
+    if (!accepts(surface->w, surface->h)) return false;
+
+    SDL_Surface* rgba = surface;
+    if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+        rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        if (!rgba) {
+            throw std::runtime_error("Failed to convert surface: " + std::string(SDL_GetError()));
+        }
+    }
+
+    int w = rgba->w + 2 * PADDING;
+    int h = rgba->h + 2 * PADDING;
+    size_t area = static_cast<size_t>(w) * h;
+    int x = 0, y = 0;
+    uint32_t pageIndex = 0;
+    bool placed = false;
+    for (uint32_t i = 0; !placed && i < pages.size(); i++) {
+        if (allocate(i, w, h, x, y)) {
+            pageIndex = i;
+            placed = true;
+        }
+    }
+    // Места нет: сначала перепаковываются страницы с освобождённой площадью, затем заводится новая
+    for (uint32_t i = 0; !placed && i < pages.size(); i++) {
+        if (pages[i].allocatedArea - pages[i].liveArea >= area && repack(i) && allocate(i, w, h, x, y)) {
+            pageIndex = i;
+            placed = true;
+        }
+    }
+    if (!placed && pages.size() < maxPages) {
+        addPage();
+        pageIndex = static_cast<uint32_t>(pages.size() - 1);
+        placed = allocate(pageIndex, w, h, x, y);
+    }
+    if (!placed) {
+        if (rgba != surface) SDL_FreeSurface(rgba);
+        return false;
+    }
+
+    AtlasRegion region;
+    region.page = pageIndex;
+    region.x = x + PADDING;
+    region.y = y + PADDING;
+    region.w = rgba->w;
+    region.h = rgba->h;
+    updateUv(region);
+
+    Page& page = pages[pageIndex];
+    page.entries.push_back(handle);
+    page.liveArea += area;
+    blit(page, static_cast<const uint32_t*>(rgba->pixels), rgba->pitch / 4, region);
+    regions[handle] = region;
+
+    if (rgba != surface) SDL_FreeSurface(rgba);
+    return true;
+}
+
+void TextureAtlas::remove(TextureHandle handle) {
+    auto it = regions.find(handle);
+    if (it == regions.end()) return;
+    Page& page = pages[it->second.page];
+    page.liveArea -= static_cast<size_t>(it->second.w + 2 * PADDING) * (it->second.h + 2 * PADDING);
+    page.entries.erase(std::find(page.entries.begin(), page.entries.end(), handle));
+    regions.erase(it);
+}
+
+void TextureAtlas::clear() {
+    pages.clear();
+    regions.clear();
+}
+
+const AtlasRegion* TextureAtlas::find(TextureHandle handle) const {
+    auto it = regions.find(handle);
+    return it == regions.end() ? nullptr : &it->second;
+}
+
+bool TextureAtlas::takeDirtyRect(uint32_t page, SDL_Rect& rect) {
+    Page& target = pages[page];
+    if (target.dirty.w == 0 || target.dirty.h == 0) return false;
+    rect = target.dirty;
+    target.dirty = {0, 0, 0, 0};
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "TextureRegistry.h"
+#include <SDL2/SDL.h>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Положение изображения внутри страницы атласа
+struct AtlasRegion {
+    uint32_t page = 0;
+    int x = 0, y = 0, w = 0, h = 0; // В пикселях страницы, без полей
+    float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+};
+
+// Упаковка мелких изображений (интерфейс, текст, спрайты) в большие страницы RGBA32.
+// Атлас не зависит от API рендеринга: он хранит копию страниц в памяти и отдаёт модулям
+// грязные области для выгрузки, а модули рисуют по UV из AtlasRegion.
+class TextureAtlas {
+private:
+    // Отрезок горизонта: занята вся высота до y на [x, x + width)
+    struct SkylineNode {
+        int x, y, width;
+    };
+
+    struct Page {
+        std::vector<uint32_t> pixels;
+        std::vector<SkylineNode> skyline;
+        std::vector<TextureHandle> entries;
+        size_t allocatedArea = 0; // Площадь, отданная упаковщиком (вместе с освобождённой)
+        size_t liveArea = 0;      // Площадь живых изображений
+        SDL_Rect dirty = {0, 0, 0, 0};
+    };
+
+    int pageSize;
+    int maxEntrySize;
+    size_t maxPages;
+    std::vector<Page> pages;
+    std::unordered_map<TextureHandle, AtlasRegion> regions;
+
+    static bool findPosition(const std::vector<SkylineNode>& skyline, int pageSize, int w, int h, int& outX, int& outY, size_t& outNode);
+    static void placeRect(std::vector<SkylineNode>& skyline, size_t node, int x, int y, int w, int h);
+    bool allocate(uint32_t pageIndex, int w, int h, int& x, int& y);
+    bool repack(uint32_t pageIndex);
+    void blit(Page& page, const uint32_t* src, int srcPitch, const AtlasRegion& region);
+    void markDirty(Page& page, int x, int y, int w, int h);
+    void updateUv(AtlasRegion& region) const;
+    void addPage();
+
+public:
+    // Поле в 1 пиксель вокруг каждого изображения повторяет его края, чтобы фильтрация не цепляла соседей
+    static const int PADDING = 1;
+
+    TextureAtlas(int pageSize = 2048, int maxEntrySize = 256, size_t maxPages = 4);
+
+    // Подходит ли изображение по размеру для упаковки
+    bool accepts(int w, int h) const;
+    // Копирует поверхность в атлас, заменяя прежнюю область handle; false — места нет, изображение
+    // нужно хранить отдельно (прежняя область при этом тоже освобождается)
+    bool insert(TextureHandle handle, SDL_Surface* surface);
+    // Освобождает место; оно будет переиспользовано при перепаковке страницы
+    void remove(TextureHandle handle);
+    void clear();
+
+    const AtlasRegion* find(TextureHandle handle) const;
+    size_t pageCount() const { return pages.size(); }
+    int getPageSize() const { return pageSize; }
+    const uint32_t* pagePixels(uint32_t page) const { return pages[page].pixels.data(); }
+    // Область страницы, изменённая с прошлого вызова; false — выгружать нечего
+    bool takeDirtyRect(uint32_t page, SDL_Rect& rect);
+};
+
+#endif // TEXTURE_ATLAS_H
@@ -0,0 +1,42 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Плотный целочисленный идентификатор текстуры: индекс в плоских массивах модулей рендеринга
+using TextureHandle = uint32_t;
+constexpr TextureHandle INVALID_TEXTURE = UINT32_MAX;
+
+// Интернирование имён текстур. Поиск по имени происходит только на границе API
+// (loadImage/renderText); при отрисовке модули индексируют массивы по TextureHandle.
+class TextureRegistry {
+private:
+    std::unordered_map<std::string, TextureHandle> handles;
+    std::vector<std::string> names;
+
+public:
+    // Возвращает существующий идентификатор или выдаёт следующий по порядку
+    TextureHandle intern(const std::string& name) {
+        auto [it, inserted] = handles.try_emplace(name, static_cast<TextureHandle>(names.size()));
+        if (inserted) names.push_back(name);
+        return it->second;
+    }
+
+    TextureHandle find(const std::string& name) const {
+        auto it = handles.find(name);
+        return it == handles.end() ? INVALID_TEXTURE : it->second;
+    }
+
+    const std::string& name(TextureHandle handle) const { return names[handle]; }
+    size_t size() const { return names.size(); }
+
+    void clear() {
+        handles.clear();
+        names.clear();
+    }
+};
+
+#endif // TEXTURE_REGISTRY_H
@@ -0,0 +1,122 @@
+#include "TextureResidency.h"
+#include <algorithm>
+
+TextureResidency::TextureResidency(size_t budgetBytes, uint32_t protectedFrames)
+    : protectedFrames(std::max(1u, protectedFrames)) {
+    counters.budgetBytes = budgetBytes;
+}
+
+TextureResidency::Entry& TextureResidency::entry(TextureHandle handle) {
+    if (handle >= entries.size()) entries.resize(handle + 1);
+    return entries[handle];
+}
+
+void TextureResidency::link(TextureHandle handle) {
+    Entry& e = entries[handle];
+    e.prev = NONE;
+    e.next = head;
+    if (head != NONE) entries[head].prev = handle;
+    head = handle;
+    if (tail == NONE) tail = handle;
+    e.linked = true;
+}
+
+void TextureResidency::unlink(TextureHandle handle) {
+    Entry& e = entries[handle];
+    if (!e.linked) return;
+    if (e.prev != NONE) entries[e.prev].next = e.next;
+    else head = e.next;
+    if (e.next != NONE) entries[e.next].prev = e.prev;
+    else tail = e.prev;
+    e.prev = NONE;
+    e.next = NONE;
+    e.linked = false;
+}
+
+void TextureResidency::add(TextureHandle handle, size_t bytes, bool reloadable, bool mipmaps) {
+    Entry& e = entry(handle);
+    if (e.state == State::Resident) {
+        counters.residentBytes -= e.bytes;
+    } else {
+        if (e.state == State::Evicted) counters.reloads++;
+        counters.residentTextures++;
+    }
+    e.state = State::Resident;
+    e.bytes = bytes;
+    e.reloadable = reloadable;
+    e.mipmaps = mipmaps;
+    e.lastUsedFrame = frame;
+    counters.residentBytes += bytes;
+    counters.peakResidentBytes = std::max(counters.peakResidentBytes, counters.residentBytes);
+    unlink(handle);
+    if (!e.pinned) link(handle);
+}
+
+void TextureResidency::remove(TextureHandle handle) {
+    if (handle >= entries.size()) return;
+    Entry& e = entries[handle];
+    if (e.state == State::Resident) {
+        counters.residentBytes -= e.bytes;
+        counters.residentTextures--;
+    }
+    unlink(handle);
+    e = Entry();
+}
+
+void TextureResidency::setPinned(TextureHandle handle, bool pinned) {
+    if (handle >= entries.size()) return;
+    Entry& e = entries[handle];
+    if (e.state != State::Resident || e.pinned == pinned) return;
+    e.pinned = pinned;
+    if (pinned) {
+        unlink(handle);
+    } else {
+        e.lastUsedFrame = frame;
+        link(handle);
+    }
+}
+
+void TextureResidency::touch(TextureHandle handle) {
+    if (handle >= entries.size()) return;
+    Entry& e = entries[handle];
+    if (e.state != State::Resident) return;
+    e.lastUsedFrame = frame;
+    if (e.linked && head != handle) {
+        unlink(handle);
+        link(handle);
+    }
+}
+
+void TextureResidency::collect(std::vector<TextureHandle>& evicted) {
+    evicted.clear();
+    if (counters.budgetBytes == 0) return;
+    while (counters.residentBytes > counters.budgetBytes && tail != NONE) {
+        TextureHandle handle = tail;
+        Entry& e = entries[handle];
+        // В хвосте — самая давняя текстура; если её ещё читают кадры в полёте, вытеснять нечего
+        if (e.lastUsedFrame + protectedFrames > frame) break;
+        unlink(handle);
+        counters.residentBytes -= e.bytes;
+        counters.residentTextures--;
+        counters.evictions++;
+        e.state = e.reloadable ? State::Evicted : State::Unknown;
+        e.bytes = 0;
+        evicted.push_back(handle);
+    }
+}
+
+void TextureResidency::reloadFailed(TextureHandle handle) {
+    if (!isEvicted(handle)) return;
+    entries[handle].state = State::Unknown;
+    counters.failedReloads++;
+}
+
+void TextureResidency::clear() {
+    size_t budgetBytes = counters.budgetBytes;
+    entries.clear();
+    head = NONE;
+    tail = NONE;
+    frame = 0;
+    counters = ResidencyStats();
+    counters.budgetBytes = budgetBytes;
+}
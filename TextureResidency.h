@@ -0,0 +1,88 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include "TextureRegistry.h"
+#include "AssetPrefetcher.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct ResidencyStats {
+    size_t budgetBytes = 0;       // 0 — без ограничения
+    size_t residentBytes = 0;
+    size_t peakResidentBytes = 0;
+    size_t residentTextures = 0;
+    uint64_t evictions = 0;
+    uint64_t reloads = 0;         // Вытесненные текстуры, загруженные снова при обращении
+    uint64_t failedReloads = 0;
+};
+
+// Источник вытесненных текстур: декодирует изображение по имени, под которым оно было загружено
+using TextureSource = std::function<DecodedImage(const std::string& name)>;
+
+// Учёт отдельных текстур модуля рендеринга в видеопамяти с бюджетом и вытеснением по LRU.
+// Как и атлас, не зависит от API: модуль сообщает о созданных текстурах и их использовании
+// в кадре, а collect() называет текстуры, память которых нужно освободить. Страницы атласа
+// не учитываются — их число и так ограничено.
+class TextureResidency {
+private:
+    static const TextureHandle NONE = INVALID_TEXTURE;
+
+    enum class State : uint8_t { Unknown, Resident, Evicted };
+
+    struct Entry {
+        State state = State::Unknown;
+        bool reloadable = false; // Можно загрузить снова через TextureSource; текст создаётся заново сценарием
+        bool mipmaps = false;
+        bool pinned = false;     // Пока идёт загрузка, текстуру нельзя вытеснять
+        size_t bytes = 0;
+        uint64_t lastUsedFrame = 0;
+        TextureHandle prev = NONE; // Список LRU: от недавно использованных к давним
+        TextureHandle next = NONE;
+        bool linked = false;
+    };
+
+    std::vector<Entry> entries;
+    TextureHandle head = NONE;
+    TextureHandle tail = NONE;
+    uint64_t frame = 0;
+    uint32_t protectedFrames;
+    ResidencyStats counters;
+
+    Entry& entry(TextureHandle handle);
+    void link(TextureHandle handle);
+    void unlink(TextureHandle handle);
+
+public:
+    // protectedFrames — сколько последних кадров (включая текущий) ещё могут читать текстуру на GPU
+    explicit TextureResidency(size_t budgetBytes = 0, uint32_t protectedFrames = 1);
+
+    void setBudget(size_t budgetBytes) { counters.budgetBytes = budgetBytes; }
+    void setProtectedFrames(uint32_t frames) { protectedFrames = frames < 1 ? 1 : frames; }
+
+    void beginFrame() { frame++; }
+    // Текстура создана или перезаписана. Повторный вызов для вытесненной считается восстановлением
+    void add(TextureHandle handle, size_t bytes, bool reloadable, bool mipmaps = false);
+    // Текстура уничтожена модулем вне collect()
+    void remove(TextureHandle handle);
+    void setPinned(TextureHandle handle, bool pinned);
+    // Текстура рисуется в текущем кадре
+    void touch(TextureHandle handle);
+
+    bool isEvicted(TextureHandle handle) const {
+        return handle < entries.size() && entries[handle].state == State::Evicted;
+    }
+    bool hasMipmaps(TextureHandle handle) const { return handle < entries.size() && entries[handle].mipmaps; }
+
+    // Давно не использованные текстуры сверх бюджета. Модуль освобождает их память; невосстановимые
+    // забываются, остальные загружаются снова при следующем обращении
+    void collect(std::vector<TextureHandle>& evicted);
+    // Источник не смог вернуть вытесненную текстуру; повторных попыток не будет
+    void reloadFailed(TextureHandle handle);
+    void clear();
+
+    ResidencyStats stats() const { return counters; }
+};
+
+#endif // TEXTURE_RESIDENCY_H
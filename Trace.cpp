@@ -0,0 +1,113 @@
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const size_t RING_CAPACITY = 1 << 16; // Событий на поток; старые перезаписываются
+
+struct TraceEvent {
+    const char* name;
+    uint64_t startNs;
+    uint64_t durationNs;
+};
+
+struct ThreadBuffer {
+    uint32_t threadId;
+    const char* threadName = nullptr;
+    std::atomic<uint64_t> written{0};
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(RING_CAPACITY);
+};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>>& registry() {
+    // Буферы живут до конца процесса, чтобы события завершившихся потоков попали в файл
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    return buffers;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto& buffers = registry();
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+        buffer->threadId = static_cast<uint32_t>(buffers.size());
+    }
+    return *buffer;
+}
+
+const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+void writeEscaped(std::ofstream& out, const char* text) {
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') out << '\\';
+        out << *c;
+    }
+}
+
+// Chrome trace ожидает микросекунды; три знака после точки сохраняют наносекунды
+void writeMicros(std::ofstream& out, uint64_t ns) {
+    out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+}
+
+} // namespace
+
+namespace Trace {
+
+void setThreadName(const char* name) {
+    threadBuffer().threadName = name;
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count());
+}
+
+void record(const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer& buffer = threadBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % RING_CAPACITY] = {name, startNs, endNs - startNs};
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry()) {
+        if (buffer->threadName) {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"args\":{\"name\":\"";
+            writeEscaped(out, buffer->threadName);
+            out << "\"}}";
+            first = false;
+        }
+
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = written > RING_CAPACITY ? written - RING_CAPACITY : 0;
+        for (uint64_t i = begin; i < written; i++) {
+            const TraceEvent& event = buffer->events[i % RING_CAPACITY];
+            out << (first ? "" : ",") << "\n{\"name\":\"";
+            writeEscaped(out, event.name);
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":";
+            writeMicros(out, event.startNs);
+            out << ",\"dur\":";
+            writeMicros(out, event.durationNs);
+            out << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
+
+} // namespace Trace
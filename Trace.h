@@ -0,0 +1,50 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <cstdint>
+
+// Замеры горячих путей движка в формате Chrome trace events (chrome://tracing, Perfetto).
+// Включается опцией CMake ENABLE_TRACE; без неё VNE_TRACE_SCOPE раскрывается в пустое выражение.
+//
+//   void VisualNovelEngine::render() {
+//       VNE_TRACE_SCOPE("VisualNovelEngine::render");
+//       ...
+//   }
+//
+// Каждый поток пишет в собственный кольцевой буфер без блокировок; writeChromeTrace()
+// следует вызывать в спокойной точке (например, при завершении), когда потоки не пишут события.
+
+namespace Trace {
+
+// Имя должно быть строковым литералом: в буфер сохраняется только указатель
+void setThreadName(const char* name);
+uint64_t nowNs();
+void record(const char* name, uint64_t startNs, uint64_t endNs);
+bool writeChromeTrace(const std::string& path);
+
+} // namespace Trace
+
+class TraceScope {
+private:
+    const char* name;
+    uint64_t startNs;
+
+public:
+    explicit TraceScope(const char* name) : name(name), startNs(Trace::nowNs()) {}
+    ~TraceScope() { Trace::record(name, startNs, Trace::nowNs()); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#ifdef VNE_ENABLE_TRACE
+#define VNE_TRACE_CONCAT_IMPL(a, b) a##b
+#define VNE_TRACE_CONCAT(a, b) VNE_TRACE_CONCAT_IMPL(a, b)
+#define VNE_TRACE_SCOPE(name) TraceScope VNE_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define VNE_TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#else
+#define VNE_TRACE_SCOPE(name) ((void)0)
+#define VNE_TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -1,23 +1,58 @@
 #include "VisualNovelEngine.h"
 #include "libs/standard/opengl/opengl.h"
 #include "libs/standard/vulkan/vulkan.h"
+#include "libs/standard/software/software.h"
+#include "BinaryScript.h"
+#include "RenderThread.h"
+#include "Trace.h"
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <dlfcn.h>
 #endif
+#include <QtCore/QStandardPaths>
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
 
 typedef Module* (*CreateModuleFunc)();
 
+// Сколько подгруженных изображений передаётся на GPU за кадр, чтобы не создавать рывков
+static const int MAX_PREFETCH_UPLOADS_PER_FRAME = 2;
+
+// Параметры цикла кадров
+static const double UPDATE_STEP_MS = 1000.0 / 60.0;
+static const int MAX_UPDATES_PER_WAKEUP = 5;   // Защита от спирали догоняющих обновлений
+static const int IDLE_WAIT_TIMEOUT_MS = 500;   // На статичном экране цикл просыпается не чаще двух раз в секунду
+
+// Изображение становится частью нового слоя, если не менялось столько отрисованных кадров подряд:
+// только что показанное может тут же смениться, и собранный слой пропал бы зря
+static const uint32_t LAYER_STABLE_FRAMES = 2;
+
+static uint64_t hashCombine(uint64_t seed, uint64_t value) {
+    return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+}
+
 VisualNovelEngine::VisualNovelEngine(const ProjectConfig& config) : config(config) {
     loadRenderModule();
+    if (config.renderThread) {
+        auto threaded = std::make_unique<RenderThread>(std::move(renderModule));
+        renderThread = threaded.get();
+        renderModule = std::move(threaded);
+    }
     loadCustomModules();
 }
 
 VisualNovelEngine::~VisualNovelEngine() {
+    if (prefetcher) prefetcher->stop();
+#ifdef VNE_ENABLE_TRACE
+    if (!config.traceOutputPath.empty() && !Trace::writeChromeTrace(config.traceOutputPath)) {
+        std::cerr << "Failed to write trace: " << config.traceOutputPath << "\n";
+    }
+#endif
     if (renderModule) renderModule->cleanup();
     for (auto& [handle, module] : customModules) {
         if (module) module->shutdown();
@@ -31,9 +66,56 @@ VisualNovelEngine::~VisualNovelEngine() {
 
 void VisualNovelEngine::loadRenderModule() {
     if (config.renderApi == "vulkan") {
-        renderModule = std::make_unique<VulkanRenderModule>();
+        QSettings settings("libs/standard/vulkan/vulkan.cfg", QSettings::IniFormat);
+        VulkanSettings vulkanSettings;
+        vulkanSettings.bindless = settings.value("Settings/Bindless", vulkanSettings.bindless).toBool();
+        vulkanSettings.maxBindlessTextures = settings.value("Settings/MaxBindlessTextures", vulkanSettings.maxBindlessTextures).toUInt();
+        vulkanSettings.descriptorPoolSize = std::max(1u, settings.value("Settings/DescriptorPoolSize", vulkanSettings.descriptorPoolSize).toUInt());
+        vulkanSettings.memoryBlockSizeMB = std::max(1u, settings.value("Settings/MemoryBlockSizeMB", vulkanSettings.memoryBlockSizeMB).toUInt());
+        vulkanSettings.stagingBufferSizeMB = std::max(1u, settings.value("Settings/StagingBufferSizeMB", vulkanSettings.stagingBufferSizeMB).toUInt());
+        vulkanSettings.framesInFlight = std::max(1u, settings.value("Settings/FramesInFlight", vulkanSettings.framesInFlight).toUInt());
+        vulkanSettings.recordingThreads = settings.value("Settings/RecordingThreads", vulkanSettings.recordingThreads).toUInt();
+        vulkanSettings.parallelRecordingThreshold = settings.value("Settings/ParallelRecordingThreshold", vulkanSettings.parallelRecordingThreshold).toUInt();
+        vulkanSettings.compressedTextures = settings.value("Settings/CompressedTextures", vulkanSettings.compressedTextures).toBool();
+        vulkanSettings.textureBudgetMB = settings.value("Settings/TextureBudgetMB", vulkanSettings.textureBudgetMB).toUInt();
+        vulkanSettings.maxCachedLayers = settings.value("Settings/MaxCachedLayers", vulkanSettings.maxCachedLayers).toUInt();
+        vulkanSettings.incrementalPresent = settings.value("Settings/IncrementalPresent", vulkanSettings.incrementalPresent).toBool();
+        if (settings.value("Settings/PipelineCache", true).toBool()) {
+            QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+            if (!cacheDir.isEmpty() && QDir().mkpath(cacheDir)) {
+                vulkanSettings.pipelineCachePath = (cacheDir + "/vulkan_pipeline.cache").toStdString();
+            }
+        }
+        renderModule = std::make_unique<VulkanRenderModule>(vulkanSettings);
     } else if (config.renderApi == "opengl") {
-        renderModule = std::make_unique<OpenGLRenderModule>();
+        QSettings settings("libs/standard/opengl/opengl.cfg", QSettings::IniFormat);
+        OpenGLSettings openglSettings;
+        openglSettings.nativeRenderer = settings.value("Settings/NativeRenderer", openglSettings.nativeRenderer).toBool();
+        openglSettings.persistentMapping = settings.value("Settings/PersistentMapping", openglSettings.persistentMapping).toBool();
+        openglSettings.initialBatchSprites = std::max(1u, settings.value("Settings/InitialBatchSprites", openglSettings.initialBatchSprites).toUInt());
+        openglSettings.textureBudgetMB = settings.value("Settings/TextureBudgetMB", openglSettings.textureBudgetMB).toUInt();
+        openglSettings.asyncUploads = settings.value("Settings/AsyncUploads", openglSettings.asyncUploads).toBool();
+        openglSettings.uploadBuffers = std::max(1u, settings.value("Settings/UploadBuffers", openglSettings.uploadBuffers).toUInt());
+        openglSettings.maxCachedLayers = settings.value("Settings/MaxCachedLayers", openglSettings.maxCachedLayers).toUInt();
+        openglSettings.partialRedraw = settings.value("Settings/PartialRedraw", openglSettings.partialRedraw).toBool();
+        openglSettings.vsync = settings.value("Settings/VSync", openglSettings.vsync).toBool();
+        const char* clearKeys[4] = {"Settings/ClearColorR", "Settings/ClearColorG", "Settings/ClearColorB", "Settings/ClearColorA"};
+        for (int i = 0; i < 4; i++) {
+            openglSettings.clearColor[i] = settings.value(clearKeys[i], openglSettings.clearColor[i]).toFloat();
+        }
+        renderModule = std::make_unique<OpenGLRenderModule>(openglSettings);
+    } else if (config.renderApi == "software") {
+        QSettings settings("libs/standard/software/software.cfg", QSettings::IniFormat);
+        SoftwareSettings softwareSettings;
+        softwareSettings.width = settings.value("Settings/DefaultResolutionWidth", softwareSettings.width).toInt();
+        softwareSettings.height = settings.value("Settings/DefaultResolutionHeight", softwareSettings.height).toInt();
+        auto channel = [&settings](const char* key, double fallback) {
+            return static_cast<uint32_t>(settings.value(key, fallback).toDouble() * 255.0 + 0.5) & 0xFF;
+        };
+        softwareSettings.clearColor = channel("Settings/ClearColorR", 0.0) | (channel("Settings/ClearColorG", 0.0) << 8) |
+                                      (channel("Settings/ClearColorB", 0.0) << 16) | (channel("Settings/ClearColorA", 1.0) << 24);
+        softwareSettings.frameDumpDirectory = settings.value("Settings/FrameDumpDirectory", "").toString().toStdString();
+        renderModule = std::make_unique<SoftwareRenderModule>(softwareSettings);
     } else {
         throw std::runtime_error("Unsupported render API: " + config.renderApi);
     }
@@ -110,53 +192,439 @@ void VisualNovelEngine::loadCustomModules() {
 // Остальные методы остаются без изменений (init, render, loadScript, nextLine, loadImage, renderText, start)
 bool VisualNovelEngine::init(const std::string& scriptPath, const std::string& savePath) {
     if (!renderModule->init(config)) throw std::runtime_error("Failed to initialize render module");
+    SDL_Point outputSize = renderModule->outputSize();
+    damageTracker.resize(outputSize.x, outputSize.y);
     if (saveModule) {
         QSettings settings("save.cfg", QSettings::IniFormat);
         settings.setValue("Settings/SavePath", QString::fromStdString(savePath));
         if (!saveModule->init(settings)) std::cerr << "Warning: Save module initialization failed\n";
     }
-    return loadScript(scriptPath);
+    if (!loadScript(scriptPath)) return false;
+
+    prefetcher = std::make_unique<AssetPrefetcher>(config.path, config.prefetchLookahead, config.prefetchMemoryBudget);
+    prefetcher->setCompressedFormats(renderModule->compressedFormats());
+    uint32_t readyEvent = SDL_RegisterEvents(1);
+    if (readyEvent != static_cast<uint32_t>(-1)) prefetcher->setReadyEvent(readyEvent);
+    textRenderer = std::make_unique<TextRenderer>(*renderModule);
+    // Вытесненные текстуры декодируются синхронно тем же путём, что и при подгрузке; глифы растеризуются заново.
+    // С потоком рендеринга источник вызывается на нём
+    AssetPrefetcher* source = prefetcher.get();
+    TextRenderer* text = textRenderer.get();
+    renderModule->setTextureSource([source, text](const std::string& name) {
+        return TextRenderer::isGlyphName(name) ? text->reload(name) : source->decode(name);
+    });
+    prefetcher->start();
+    prefetcher->scan(*script, currentLineIndex);
+    return true;
+}
+
+bool VisualNovelEngine::render() {
+    VNE_TRACE_SCOPE("VisualNovelEngine::render");
+    if (!renderModule) {
+        std::cerr << "No render module loaded!\n";
+        return false;
+    }
+    if (config.partialRedraw) {
+        // Догруженная текстура появляется без изменения списка изображений
+        if (renderModule->hasPendingUploads()) damageTracker.invalidate();
+        damageTracker.update(currentImages, textureVersions, frameDamage);
+        if (!frameDamage.full && frameDamage.rects.empty()) return false;
+        renderModule->setDamage(frameDamage);
+    }
+    if (config.layerCache) {
+        detectLayers();
+        renderModule->renderLayers(currentImages, renderLayers);
+    } else {
+        renderModule->render(currentImages);
+    }
+    return true;
 }
 
-void VisualNovelEngine::render() {
-    if (renderModule) renderModule->render(currentImages);
-    else std::cerr << "No render module loaded!\n";
+// Слой — подряд идущие видимые изображения, не менявшиеся LAYER_STABLE_FRAMES кадров. Слой прошлого
+// кадра остаётся, пока не изменится ни одно его изображение, и не растёт за счёт соседей: иначе при
+// показе текста по буквам он собирался бы заново каждый кадр
+void VisualNovelEngine::detectLayers() {
+    VNE_TRACE_SCOPE("VisualNovelEngine::detectLayers");
+    size_t previousCount = imageHashes.size();
+    size_t count = currentImages.size();
+    imageHashes.resize(count);
+    stableFrames.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const DisplayImage& img = currentImages[i];
+        uint32_t version = img.texture < textureVersions.size() ? textureVersions[img.texture] : 0;
+        uint64_t hash = hashCombine(img.texture, version);
+        hash = hashCombine(hash, (static_cast<uint64_t>(static_cast<uint32_t>(img.x)) << 32) | static_cast<uint32_t>(img.y));
+        hash = hashCombine(hash, (static_cast<uint64_t>(static_cast<uint32_t>(img.w)) << 32) | static_cast<uint32_t>(img.h));
+        if (i < previousCount && imageHashes[i] == hash) {
+            if (stableFrames[i] < UINT32_MAX) stableFrames[i]++;
+        } else {
+            imageHashes[i] = hash;
+            stableFrames[i] = 0;
+        }
+    }
+
+    std::vector<RenderLayer> previous;
+    previous.swap(renderLayers);
+    for (const auto& layer : previous) {
+        if (layer.first + layer.count > count) continue;
+        bool unchanged = true;
+        for (size_t i = layer.first; i < layer.first + layer.count && unchanged; i++) {
+            unchanged = stableFrames[i] > 0;
+        }
+        if (unchanged) renderLayers.push_back(layer);
+    }
+
+    // Новые слои — из участков между сохранёнными
+    size_t keptLayers = renderLayers.size();
+    size_t next = 0;
+    size_t i = 0;
+    while (i < count) {
+        if (next < keptLayers && i == renderLayers[next].first) {
+            i += renderLayers[next++].count;
+            continue;
+        }
+        size_t end = next < keptLayers ? renderLayers[next].first : count;
+        auto joinable = [this](size_t index) {
+            const DisplayImage& img = currentImages[index];
+            return stableFrames[index] >= LAYER_STABLE_FRAMES && img.texture != INVALID_TEXTURE && img.w > 0 && img.h > 0;
+        };
+        if (!joinable(i)) {
+            i++;
+            continue;
+        }
+        RenderLayer layer;
+        layer.first = i;
+        layer.key = 0;
+        layer.bounds = {currentImages[i].x, currentImages[i].y, currentImages[i].w, currentImages[i].h};
+        for (; i < end && joinable(i); i++) {
+            const DisplayImage& img = currentImages[i];
+            SDL_Rect rect = {img.x, img.y, img.w, img.h};
+            SDL_UnionRect(&layer.bounds, &rect, &layer.bounds);
+            layer.key = hashCombine(layer.key, imageHashes[i]);
+        }
+        layer.count = i - layer.first;
+        if (layer.count >= std::max<size_t>(2, config.layerMinImages)) renderLayers.push_back(layer);
+    }
+    std::sort(renderLayers.begin(), renderLayers.end(), [](const RenderLayer& a, const RenderLayer& b) { return a.first < b.first; });
 }
 
 bool VisualNovelEngine::loadScript(const std::string& scriptPath) {
-    std::ifstream scriptFile(scriptPath);
-    if (!scriptFile.is_open()) {
+    if (loadBinaryScript(scriptPath)) {
+        currentLineIndex = 0;
+        return true;
+    }
+
+    bool opened = false;
+    if (config.mappedScripts) {
+        auto mapped = std::make_unique<MappedScriptSource>();
+        opened = mapped->open(scriptPath);
+        if (opened) script = std::move(mapped);
+    } else {
+        auto lines = std::make_unique<VectorScriptSource>();
+        opened = lines->open(scriptPath);
+        if (opened) script = std::move(lines);
+    }
+    if (!opened) {
         std::cerr << "Failed to open script file: " << scriptPath << "\n";
         return false;
     }
-    std::string line;
-    while (std::getline(scriptFile, line)) scriptLines.push_back(line);
-    scriptFile.close();
     currentLineIndex = 0;
     return true;
 }
 
+bool VisualNovelEngine::loadBinaryScript(const std::string& scriptPath) {
+    std::string vnbPath = binaryScriptPath(scriptPath);
+    std::error_code ec;
+    if (!std::filesystem::exists(vnbPath, ec)) return false;
+
+    // Устаревший .vnb игнорируется: текст правили после компиляции
+    if (std::filesystem::exists(scriptPath, ec) &&
+        std::filesystem::last_write_time(scriptPath, ec) > std::filesystem::last_write_time(vnbPath, ec)) {
+        std::cerr << "Compiled script is older than " << scriptPath << ", using text format\n";
+        return false;
+    }
+
+    auto binary = std::make_unique<BinaryScriptSource>();
+    if (!binary->open(vnbPath)) {
+        std::cerr << "Invalid compiled script: " << vnbPath << ", using text format\n";
+        return false;
+    }
+    script = std::move(binary);
+    return true;
+}
+
 bool VisualNovelEngine::nextLine() {
-    if (currentLineIndex >= scriptLines.size()) return false;
-    currentImages.clear();
+    VNE_TRACE_SCOPE("VisualNovelEngine::nextLine");
+    if (currentLineIndex >= scriptLineCount()) return false;
+    clearScreen();
     currentLineIndex++;
+    frameDirty = true;
+    if (prefetcher) prefetcher->scan(*script, currentLineIndex);
+    return true;
+}
+
+bool VisualNovelEngine::jumpToLine(size_t lineIndex) {
+    if (lineIndex > scriptLineCount()) return false;
+    clearScreen();
+    currentLineIndex = lineIndex;
+    frameDirty = true;
+    if (prefetcher) prefetcher->scan(*script, currentLineIndex);
     return true;
 }
 
-void VisualNovelEngine::loadImage(const std::string& imageName, SDL_Surface* surface) {
-    if (renderModule) {
-        renderModule->loadImage(imageName, surface);
-        currentImages.push_back({imageName, 0, 0, surface->w, surface->h});
+std::string_view VisualNovelEngine::currentLine() const {
+    if (!script || currentLineIndex == 0) return {};
+    return script->line(currentLineIndex - 1);
+}
+
+size_t VisualNovelEngine::scriptLineCount() const {
+    return script ? script->lineCount() : 0;
+}
+
+TextureHandle VisualNovelEngine::loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps) {
+    VNE_TRACE_SCOPE("VisualNovelEngine::loadImage");
+    if (!renderModule) return INVALID_TEXTURE;
+    TextureHandle texture = renderModule->loadImage(imageName, surface, mipmaps);
+    currentImages.push_back({imageName, 0, 0, surface->w, surface->h, texture});
+    frameDirty = true;
+    return texture;
+}
+
+bool VisualNovelEngine::loadImageFile(const std::string& imagePath) {
+    if (!renderModule) return false;
+
+    auto loaded = loadedImages.find(imagePath);
+    if (loaded != loadedImages.end()) {
+        if (prefetcher) prefetcher->recordHit();
+        currentImages.push_back({imagePath, 0, 0, loaded->second.w, loaded->second.h, loaded->second.texture});
+        frameDirty = true;
+        return true;
     }
+
+    DecodedImage image = prefetcher ? prefetcher->acquire(imagePath) : DecodedImage{};
+    if (!image) return false;
+    LoadedImage uploaded = uploadDecodedImage(imagePath, image);
+    loadedImages[imagePath] = uploaded;
+    currentImages.push_back({imagePath, 0, 0, uploaded.w, uploaded.h, uploaded.texture});
+    frameDirty = true;
+    return true;
+}
+
+// Сжатые блоки уходят в модуль как есть, поверхность освобождается после загрузки
+LoadedImage VisualNovelEngine::uploadDecodedImage(const std::string& path, DecodedImage& image) {
+    VNE_TRACE_SCOPE("VisualNovelEngine::uploadDecodedImage");
+    LoadedImage uploaded;
+    if (image.compressed) {
+        uploaded = {renderModule->loadCompressedImage(path, *image.compressed), image.compressed->width, image.compressed->height};
+    } else {
+        uploaded = {renderModule->loadImage(path, image.surface), image.surface->w, image.surface->h};
+        SDL_FreeSurface(image.surface);
+    }
+    image = {};
+    return uploaded;
+}
+
+void VisualNovelEngine::uploadPrefetchedImages() {
+    if (!prefetcher || !renderModule) return;
+    std::string path;
+    DecodedImage image;
+    for (int i = 0; i < MAX_PREFETCH_UPLOADS_PER_FRAME && prefetcher->popDecoded(path, image); i++) {
+        if (loadedImages.find(path) == loadedImages.end()) {
+            loadedImages[path] = uploadDecodedImage(path, image);
+        } else if (image.surface) {
+            SDL_FreeSurface(image.surface);
+        }
+        image = {};
+    }
+}
+
+PrefetchStats VisualNovelEngine::prefetchStats() const {
+    return prefetcher ? prefetcher->stats() : PrefetchStats{};
+}
+
+ResidencyStats VisualNovelEngine::residencyStats() const {
+    return renderModule ? renderModule->residencyStats() : ResidencyStats{};
 }
 
-void VisualNovelEngine::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
-    if (renderModule) {
-        renderModule->renderText(textKey, surface, x, y, w, h);
-        currentImages.push_back({textKey, x, y, w, h});
+LayerCacheStats VisualNovelEngine::layerCacheStats() const {
+    return renderModule ? renderModule->layerCacheStats() : LayerCacheStats{};
+}
+
+RenderThreadStats VisualNovelEngine::renderThreadStats() const {
+    return renderThread ? renderThread->stats() : RenderThreadStats{};
+}
+
+TextureHandle VisualNovelEngine::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
+    VNE_TRACE_SCOPE("VisualNovelEngine::renderText");
+    if (!renderModule) return INVALID_TEXTURE;
+    TextureHandle texture = renderModule->renderText(textKey, surface, x, y, w, h);
+    // Тот же ключ мог получить новый текст: слои с прежним содержимым больше не годятся
+    if (texture != INVALID_TEXTURE) {
+        if (texture >= textureVersions.size()) textureVersions.resize(texture + 1, 0);
+        textureVersions[texture]++;
+    }
+    currentImages.push_back({textKey, x, y, w, h, texture});
+    frameDirty = true;
+    return texture;
+}
+
+FontHandle VisualNovelEngine::loadFont(const std::string& fontPath, int size) {
+    return textRenderer ? textRenderer->loadFont(fontPath, size) : INVALID_FONT;
+}
+
+size_t VisualNovelEngine::drawText(FontHandle font, const std::string& text, int x, int y, int wrapWidth, SDL_Color color, size_t revealed) {
+    VNE_TRACE_SCOPE("VisualNovelEngine::drawText");
+    if (!textRenderer) return SIZE_MAX;
+    std::shared_ptr<const TextLayout> layout = textRenderer->layout(font, text, wrapWidth, color);
+    if (!layout) return SIZE_MAX;
+
+    // Все глифы попадают в список сразу; скрытые рисуются без текстуры и модулями пропускаются
+    TextBlock block;
+    block.layout = layout;
+    block.firstImage = currentImages.size();
+    block.revealed = std::min<size_t>(revealed, layout->characters);
+    for (const auto& quad : layout->quads) {
+        TextureHandle texture = quad.index < block.revealed ? quad.texture : INVALID_TEXTURE;
+        currentImages.push_back({std::string(), x + quad.x, y + quad.y, quad.w, quad.h, texture});
     }
+    textBlocks.push_back(std::move(block));
+    frameDirty = true;
+    return textBlocks.size() - 1;
+}
+
+void VisualNovelEngine::revealText(size_t block, size_t characters) {
+    if (block >= textBlocks.size()) return;
+    TextBlock& text = textBlocks[block];
+    characters = std::min<size_t>(characters, text.layout->characters);
+    if (characters == text.revealed) return;
+    // Глифы упорядочены по номеру символа, поэтому меняется только отрезок между старой и новой границей
+    const auto& quads = text.layout->quads;
+    size_t from = std::min(characters, text.revealed);
+    size_t to = std::max(characters, text.revealed);
+    for (size_t i = 0; i < quads.size(); i++) {
+        if (quads[i].index < from) continue;
+        if (quads[i].index >= to) break;
+        currentImages[text.firstImage + i].texture = quads[i].index < characters ? quads[i].texture : INVALID_TEXTURE;
+    }
+    text.revealed = characters;
+    frameDirty = true;
+}
+
+size_t VisualNovelEngine::textLength(size_t block) const {
+    return block < textBlocks.size() ? textBlocks[block].layout->characters : 0;
+}
+
+TextStats VisualNovelEngine::textStats() const {
+    return textRenderer ? textRenderer->stats() : TextStats{};
+}
+
+void VisualNovelEngine::clearScreen() {
+    currentImages.clear();
+    textBlocks.clear();
+}
+
+void VisualNovelEngine::handleEvent(const SDL_Event& event) {
+    switch (event.type) {
+    case SDL_QUIT:
+        running = false;
+        break;
+    case SDL_WINDOWEVENT:
+        if (event.window.event == SDL_WINDOWEVENT_EXPOSED || event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED ||
+            event.window.event == SDL_WINDOWEVENT_RESTORED) {
+            // Содержимое окна могло пропасть целиком
+            frameDirty = true;
+            damageTracker.invalidate();
+        }
+        break;
+    case SDL_MOUSEBUTTONDOWN:
+        if (event.button.button == SDL_BUTTON_LEFT && !nextLine()) running = false;
+        break;
+    case SDL_KEYDOWN:
+        if (event.key.repeat) break;
+        if (event.key.keysym.sym == SDLK_SPACE || event.key.keysym.sym == SDLK_RETURN) {
+            if (!nextLine()) running = false;
+        } else if (event.key.keysym.sym == SDLK_ESCAPE) {
+            running = false;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void VisualNovelEngine::update() {
+    uploadPrefetchedImages();
+    // Асинхронно загружаемые текстуры появятся только после очередной отрисовки
+    if (renderModule && renderModule->hasPendingUploads()) frameDirty = true;
+    frameStats.updates++;
+}
+
+bool VisualNovelEngine::hasPendingWork() const {
+    return (prefetcher && prefetcher->hasDecoded()) || (renderModule && renderModule->hasPendingUploads());
+}
+
+// С потоком рендеринга кадр здесь только публикуется; время отрисовки и показа — в renderThreadStats
+void VisualNovelEngine::presentFrame() {
+    auto begin = std::chrono::steady_clock::now();
+    bool presented = render();
+    double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    frameDirty = false;
+    if (!presented) return;
+    frameStats.framesPresented++;
+    frameStats.lastFrameMs = frameMs;
+    frameStats.maxFrameMs = std::max(frameStats.maxFrameMs, frameMs);
+    frameStats.averageFrameMs += (frameMs - frameStats.averageFrameMs) / static_cast<double>(frameStats.framesPresented);
 }
 
 void VisualNovelEngine::start() {
-    while (nextLine()) render();
+    using Clock = std::chrono::steady_clock;
+    VNE_TRACE_THREAD_NAME("Main");
+
+    running = nextLine();
+    frameDirty = true;
+    auto previousTime = Clock::now();
+    double accumulatorMs = 0.0;
+
+    while (running) {
+        SDL_Event event;
+        if (!frameDirty) {
+            // Кадр не менялся: вместо холостой отрисовки блокируемся на вводе.
+            // При фоновой работе ждём только до следующего шага обновления.
+            bool pendingWork = hasPendingWork();
+            int timeoutMs = pendingWork ? std::max(1, static_cast<int>(UPDATE_STEP_MS - accumulatorMs)) : IDLE_WAIT_TIMEOUT_MS;
+            if (!pendingWork) frameStats.idleWaits++;
+            bool woke;
+            {
+                VNE_TRACE_SCOPE("Idle wait");
+                woke = SDL_WaitEventTimeout(&event, timeoutMs) != 0;
+            }
+            if (woke) handleEvent(event);
+            if (!pendingWork) {
+                // После простоя не догоняем пропущенные шаги
+                previousTime = Clock::now();
+                accumulatorMs = UPDATE_STEP_MS;
+            }
+        }
+        frameStats.wakeups++;
+        while (running && SDL_PollEvent(&event)) handleEvent(event);
+        if (!running) break;
+
+        auto now = Clock::now();
+        accumulatorMs += std::chrono::duration<double, std::milli>(now - previousTime).count();
+        previousTime = now;
+        int steps = 0;
+        while (accumulatorMs >= UPDATE_STEP_MS && steps < MAX_UPDATES_PER_WAKEUP) {
+            update();
+            accumulatorMs -= UPDATE_STEP_MS;
+            steps++;
+        }
+        if (steps == MAX_UPDATES_PER_WAKEUP) accumulatorMs = 0.0;
+
+        if (frameDirty) presentFrame();
+    }
+}
+
+void VisualNovelEngine::stop() {
+    running = false;
 }
\ No newline at end of file
@@ -8,6 +8,15 @@
 #include <stdexcept>
 #include <QtCore/QSettings>
 #include <QtCore/QDir>
+#include <unordered_map>
+#include "ScriptSource.h"
+#include "AssetPrefetcher.h"
+#include "TextureRegistry.h"
+#include "CompressedTexture.h"
+#include "TextureResidency.h"
+#include "TextRenderer.h"
+#include "LayerCache.h"
+#include "DamageTracker.h"
 
 #ifdef _WIN32
 #define MODULE_EXT ".dll"
@@ -17,13 +26,56 @@
 
 struct ProjectConfig {
     std::string path;
-    std::string renderApi; // "opengl" или "vulkan"
+    std::string renderApi; // "opengl", "vulkan" или "software"
     std::vector<std::string> libraries; // Список модулей
+    bool mappedScripts = true; // false — старый путь загрузки сценария через std::vector<std::string>
+    size_t prefetchLookahead = 32; // Сколько строк вперёд просматривает подгрузчик (0 — отключён)
+    size_t prefetchMemoryBudget = 256 * 1024 * 1024; // Предел декодированных, но не загруженных изображений
+    std::string traceOutputPath = "trace.json"; // Куда пишется трасса при сборке с ENABLE_TRACE
+    bool layerCache = false; // Неизменные участки кадра передаются модулю как слои для кэширования
+    size_t layerMinImages = 2; // Сколько изображений подряд должно не меняться, чтобы стать слоем
+    bool partialRedraw = true; // Перерисовывать только изменившиеся области; кадр без изменений не показывается
+    bool renderThread = false; // Модуль рендеринга работает на своём потоке и получает снимки кадров
+};
+
+struct FrameStats {
+    uint64_t framesPresented = 0;
+    uint64_t updates = 0;      // Шаги обновления с фиксированным шагом
+    uint64_t wakeups = 0;      // Пробуждения цикла: события ввода, окна или таймер
+    uint64_t idleWaits = 0;    // Блокировки в ожидании ввода на статичном экране
+    double lastFrameMs = 0.0;
+    double averageFrameMs = 0.0;
+    double maxFrameMs = 0.0;
+};
+
+// Поток рендеринга (ProjectConfig::renderThread); время кадра — отрисовка и показ на этом потоке
+struct RenderThreadStats {
+    uint64_t framesSubmitted = 0; // Снимков, опубликованных потоком сценария
+    uint64_t framesRendered = 0;
+    uint64_t framesDropped = 0;   // Заменены более свежим снимком, не дойдя до экрана
+    uint64_t calls = 0;           // Синхронных вызовов модуля с потока сценария (загрузки, статистика)
+    double lastFrameMs = 0.0;
+    double averageFrameMs = 0.0;
+    double maxFrameMs = 0.0;
 };
 
 struct DisplayImage {
     std::string name;
     int x, y, w, h;
+    TextureHandle texture = INVALID_TEXTURE; // Выдаётся модулем рендеринга в loadImage/renderText
+};
+
+// Изображение, уже загруженное в модуль рендеринга
+struct LoadedImage {
+    TextureHandle texture;
+    int w, h;
+};
+
+// Текст на экране: его глифы занимают currentImages[firstImage, firstImage + layout->quads.size())
+struct TextBlock {
+    std::shared_ptr<const TextLayout> layout;
+    size_t firstImage = 0;
+    size_t revealed = 0;
 };
 
 class RenderModule {
@@ -31,9 +83,38 @@ public:
     virtual ~RenderModule() = default;
     virtual bool init(const ProjectConfig& config) = 0;
     virtual void render(const std::vector<DisplayImage>& images) = 0;
+    // Кадр с найденными движком слоями. Модуль без кэша слоёв рисует изображения как обычно
+    virtual void renderLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>&) { render(images); }
     virtual void cleanup() = 0;
-    virtual void loadImage(const std::string& imageName, SDL_Surface* surface) = 0;
-    virtual void renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) = 0;
+    // mipmaps — цепочка уменьшенных копий для спрайтов, которые рисуются заметно меньше исходного
+    // размера (миниатюры, галерея); фонам во весь экран она не нужна
+    virtual TextureHandle loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps = false) = 0;
+    virtual TextureHandle renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) = 0;
+    // Форматы сжатых текстур, которые модуль загружает без распаковки (маска textureFormatBit)
+    virtual uint32_t compressedFormats() const { return 0; }
+    // По умолчанию блоки распаковываются на CPU и загружаются через loadImage
+    virtual TextureHandle loadCompressedImage(const std::string& imageName, const CompressedTexture& texture) {
+        SDL_Surface* surface = decompressTexture(texture);
+        if (!surface) return INVALID_TEXTURE;
+        TextureHandle handle = loadImage(imageName, surface);
+        SDL_FreeSurface(surface);
+        return handle;
+    }
+    // Есть загрузки текстур, которые ещё не видны на экране; они продвигаются вызовами render()
+    virtual bool hasPendingUploads() const { return false; }
+    // Откуда модуль загружает снова текстуры, вытесненные из видеопамяти по бюджету
+    virtual void setTextureSource(TextureSource) {}
+    virtual ResidencyStats residencyStats() const { return {}; }
+    virtual LayerCacheStats layerCacheStats() const { return {}; }
+    // Области следующего кадра, которые нужно перерисовать; действует на один render. Модуль,
+    // который не хранит прошлый кадр, рисует всё
+    virtual void setDamage(const FrameDamage&) {}
+    // Размер кадра в координатах DisplayImage: за его пределами модуль ничего не рисует
+    virtual SDL_Point outputSize() const { return {1920, 1080}; }
+    // Переход на поток рендеринга: detachThread вызывается на потоке, где прошёл init, attachThread —
+    // на потоке, который дальше работает с модулем (например, для контекста OpenGL)
+    virtual void detachThread() {}
+    virtual void attachThread() {}
 };
 
 class Module {
@@ -49,30 +130,79 @@ public:
     virtual std::string load() = 0;
 };
 
+class RenderThread;
+
 class VisualNovelEngine {
 private:
     std::unique_ptr<RenderModule> renderModule;
+    RenderThread* renderThread = nullptr; // renderModule, если модуль работает на своём потоке
     std::unique_ptr<SaveModule> saveModule;
-    std::vector<std::string> scriptLines;
+    std::unique_ptr<ScriptSource> script;
     std::vector<DisplayImage> currentImages;
     size_t currentLineIndex = 0;
     ProjectConfig config;
     std::vector<std::pair<void*, std::unique_ptr<Module>>> customModules;
+    std::unique_ptr<AssetPrefetcher> prefetcher;
+    std::unordered_map<std::string, LoadedImage> loadedImages; // Уже загруженные на GPU изображения
+    std::unique_ptr<TextRenderer> textRenderer;
+    std::vector<TextBlock> textBlocks; // Текст текущего экрана; глифы лежат в currentImages
+    std::vector<uint64_t> imageHashes;   // Хэш каждого изображения прошлого кадра, для поиска слоёв
+    std::vector<uint32_t> stableFrames;  // Сколько отрисованных кадров подряд изображение не менялось
+    std::vector<RenderLayer> renderLayers;
+    std::vector<uint32_t> textureVersions; // Индексируется TextureHandle; растёт при перезаписи текста в renderText
+    DamageTracker damageTracker;
+    FrameDamage frameDamage;
+    bool running = false;
+    bool frameDirty = true; // Кадр изменился с последней отрисовки
+    FrameStats frameStats;
 
     void loadRenderModule();
     void loadCustomModules();
+    bool loadBinaryScript(const std::string& scriptPath);
+    void uploadPrefetchedImages();
+    LoadedImage uploadDecodedImage(const std::string& path, DecodedImage& image);
+    void handleEvent(const SDL_Event& event);
+    void update();
+    bool hasPendingWork() const;
+    void presentFrame();
+    void clearScreen();
+    void detectLayers();
 
 public:
     VisualNovelEngine(const ProjectConfig& config);
     ~VisualNovelEngine();
 
     bool init(const std::string& scriptPath, const std::string& savePath);
-    void render();
+    // false, если кадр не отправлен модулю: нет модуля или частичная перерисовка не нашла изменений
+    bool render();
     bool loadScript(const std::string& scriptPath);
     bool nextLine();
-    void loadImage(const std::string& imageName, SDL_Surface* surface);
-    void renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h);
+    bool jumpToLine(size_t lineIndex);
+    std::string_view currentLine() const;
+    size_t scriptLineCount() const;
+    TextureHandle loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps = false);
+    bool loadImageFile(const std::string& imagePath);
+    PrefetchStats prefetchStats() const;
+    ResidencyStats residencyStats() const;
+    LayerCacheStats layerCacheStats() const;
+    DamageStats damageStats() const { return damageTracker.stats(); }
+    RenderThreadStats renderThreadStats() const;
+    TextureHandle renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h);
+    FontHandle loadFont(const std::string& fontPath, int size);
+    // Текст из кэша глифов. Возвращает номер блока для revealText; revealed — сколько символов видно сразу
+    size_t drawText(FontHandle font, const std::string& text, int x, int y, int wrapWidth, SDL_Color color, size_t revealed = SIZE_MAX);
+    // Показ текста по буквам: меняются только видимые глифы, новых загрузок нет
+    void revealText(size_t block, size_t characters);
+    size_t textLength(size_t block) const;
+    TextStats textStats() const;
     void start();
+    void stop();
+    // Кадр перерисовывается целиком: движок не знает, что изменилось
+    void markDirty() {
+        frameDirty = true;
+        damageTracker.invalidate();
+    }
+    const FrameStats& getFrameStats() const { return frameStats; }
 };
 
 #endif // VISUAL_NOVEL_ENGINE_H
\ No newline at end of file
@@ -0,0 +1,393 @@
+// Замеры горячих путей движка. Результаты пишутся в JSON, чтобы сравнивать их между релизами.
+//
+//   vn_bench [--out results.json] [--filter substring] [--backends software,vulkan,opengl,opengl_sdl]
+#include "VisualNovelEngine.h"
+#include "ScriptSource.h"
+#include "BinaryScript.h"
+#include "CompressedTexture.h"
+#include "libs/standard/opengl/opengl.h"
+#include "libs/standard/vulkan/vulkan.h"
+#include "libs/standard/software/software.h"
+#include <QtCore/QSettings>
+#include <QtCore/QTemporaryDir>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" Module* createModule(); // Модуль сохранений собирается вместе с бенчмарком
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const double MIN_BENCH_SECONDS = 0.5;
+const int MIN_ITERATIONS = 5;
+
+struct BenchResult {
+    std::string name;
+    int iterations = 0;
+    double meanNs = 0.0;
+    double medianNs = 0.0;
+    double minNs = 0.0;
+    double maxNs = 0.0;
+    double itemsPerIteration = 1.0;
+};
+
+struct BenchOptions {
+    std::string outputPath = "vn_bench.json";
+    std::string filter;
+    std::vector<std::string> backends = {"software"};
+};
+
+class BenchRunner {
+private:
+    BenchOptions options;
+    std::vector<BenchResult> results;
+    std::vector<std::pair<std::string, VulkanPoolStats>> memory;
+
+public:
+    explicit BenchRunner(const BenchOptions& options) : options(options) {}
+
+    bool enabled(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    // body выполняет одну итерацию; первая итерация — прогрев и в результат не входит
+    void run(const std::string& name, double itemsPerIteration, int maxIterations, const std::function<void()>& body) {
+        if (!enabled(name)) return;
+        body();
+
+        std::vector<double> samples;
+        auto benchStart = Clock::now();
+        while (static_cast<int>(samples.size()) < maxIterations &&
+               (static_cast<int>(samples.size()) < MIN_ITERATIONS ||
+                std::chrono::duration<double>(Clock::now() - benchStart).count() < MIN_BENCH_SECONDS)) {
+            auto begin = Clock::now();
+            body();
+            samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - begin).count());
+        }
+
+        std::sort(samples.begin(), samples.end());
+        BenchResult result;
+        result.name = name;
+        result.iterations = static_cast<int>(samples.size());
+        for (double sample : samples) result.meanNs += sample;
+        result.meanNs /= samples.size();
+        result.medianNs = samples[samples.size() / 2];
+        result.minNs = samples.front();
+        result.maxNs = samples.back();
+        result.itemsPerIteration = itemsPerIteration;
+        results.push_back(result);
+        std::cout << name << ": " << result.medianNs / 1e6 << " ms median over " << result.iterations << " iterations\n";
+    }
+
+    // Занятость памяти GPU после замеров: по ней видно, сколько блоков держит распределитель
+    void addMemoryStats(const std::string& name, const std::vector<VulkanPoolStats>& pools) {
+        for (const auto& pool : pools) {
+            memory.push_back({name, pool});
+            std::cout << name << ": memory type " << pool.memoryType << (pool.linear ? " (linear)" : "") << ", "
+                      << pool.blockCount << " blocks, " << pool.usedBytes / 1024 << " of " << pool.reservedBytes / 1024
+                      << " KiB used, " << pool.dedicatedCount << " dedicated\n";
+        }
+    }
+
+    bool writeJson() const {
+        std::ofstream out(options.outputPath, std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << "{\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+                << ", \"mean_ns\": " << r.meanNs << ", \"median_ns\": " << r.medianNs
+                << ", \"min_ns\": " << r.minNs << ", \"max_ns\": " << r.maxNs
+                << ", \"items_per_second\": " << r.itemsPerIteration * 1e9 / r.medianNs << "}";
+        }
+        out << "\n  ],\n  \"memory\": [";
+        for (size_t i = 0; i < memory.size(); i++) {
+            const VulkanPoolStats& p = memory[i].second;
+            out << (i ? "," : "") << "\n    {\"name\": \"" << memory[i].first << "\", \"memory_type\": " << p.memoryType
+                << ", \"linear\": " << (p.linear ? "true" : "false") << ", \"blocks\": " << p.blockCount
+                << ", \"allocations\": " << p.allocationCount << ", \"reserved_bytes\": " << p.reservedBytes
+                << ", \"used_bytes\": " << p.usedBytes << ", \"largest_free_range\": " << p.largestFreeRange
+                << ", \"dedicated\": " << p.dedicatedCount << ", \"dedicated_bytes\": " << p.dedicatedBytes << "}";
+        }
+        out << "\n  ]\n}\n";
+        return out.good();
+    }
+};
+
+std::string writeSyntheticScript(const std::string& directory, size_t lineCount) {
+    std::string path = directory + "/script_" + std::to_string(lineCount) + ".txt";
+    std::ofstream out(path, std::ios::trunc);
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < lineCount; i++) {
+        switch (rng() % 8) {
+        case 0: out << "bg backgrounds/scene_" << rng() % 64 << ".png\n"; break;
+        case 1: out << "show characters/hero_" << rng() % 16 << ".png at left\n"; break;
+        case 2: out << "\n"; break;
+        case 3: out << "# route " << i / 1000 << "\n"; break;
+        default: out << "Hero: \"Line number " << i << " of a rather ordinary dialogue.\"\n"; break;
+        }
+    }
+    return path;
+}
+
+SDL_Surface* createTestSurface(int width, int height, uint32_t seed) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!surface) throw std::runtime_error("Failed to create surface: " + std::string(SDL_GetError()));
+    std::mt19937 rng(seed);
+    for (int y = 0; y < height; y++) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(surface->pixels) + y * surface->pitch);
+        for (int x = 0; x < width; x++) row[x] = rng();
+    }
+    return surface;
+}
+
+// Запасной путь для устройств без блочных форматов: распаковка фона во весь экран на CPU
+void benchTextureDecoding(BenchRunner& runner) {
+    SDL_Surface* surface = createTestSurface(1920, 1080, 3);
+    for (TextureFormat format : {TextureFormat::BC1, TextureFormat::BC3}) {
+        CompressedTexture texture;
+        std::string error;
+        if (!compressTexture(surface, format, texture, error)) throw std::runtime_error(error);
+        std::string name = std::string("texture_decode/") + (format == TextureFormat::BC1 ? "bc1" : "bc3") + "/1920x1080";
+        runner.run(name, 1.0, 200, [&] {
+            SDL_Surface* decoded = decompressTexture(texture);
+            if (!decoded) throw std::runtime_error("Failed to decode texture");
+            SDL_FreeSurface(decoded);
+        });
+    }
+    SDL_FreeSurface(surface);
+}
+
+std::unique_ptr<IRenderModule> createBackend(const std::string& backend) {
+    if (backend == "software") return std::make_unique<SoftwareRenderModule>();
+    if (backend == "vulkan") return std::make_unique<VulkanRenderModule>();
+    if (backend == "opengl") return std::make_unique<OpenGLRenderModule>();
+    if (backend == "opengl_sdl") {
+        OpenGLSettings settings;
+        settings.nativeRenderer = false;
+        return std::make_unique<OpenGLRenderModule>(settings);
+    }
+    throw std::runtime_error("Unknown backend: " + backend);
+}
+
+void benchScriptLoading(BenchRunner& runner, const std::string& directory) {
+    for (size_t lines : {1000u, 10000u, 100000u, 500000u}) {
+        std::string path = writeSyntheticScript(directory, lines);
+        std::string vnbPath = binaryScriptPath(path);
+        std::string suffix = "/" + std::to_string(lines);
+
+        runner.run("script_load/mmap" + suffix, static_cast<double>(lines), 200, [&] {
+            MappedScriptSource source;
+            if (!source.open(path)) throw std::runtime_error("Failed to open " + path);
+        });
+        runner.run("script_load/vector" + suffix, static_cast<double>(lines), 200, [&] {
+            VectorScriptSource source;
+            if (!source.open(path)) throw std::runtime_error("Failed to open " + path);
+        });
+
+        MappedScriptSource text;
+        std::string error;
+        if (!text.open(path) || !compileScript(text, vnbPath, error)) throw std::runtime_error("Failed to compile " + path + ": " + error);
+        runner.run("script_load/vnb" + suffix, static_cast<double>(lines), 200, [&] {
+            BinaryScriptSource source;
+            if (!source.open(vnbPath)) throw std::runtime_error("Failed to open " + vnbPath);
+        });
+
+        // Последовательный проход по всем строкам, как при чтении сценария
+        runner.run("script_scan/mmap" + suffix, static_cast<double>(lines), 200, [&] {
+            size_t total = 0;
+            for (size_t i = 0; i < text.lineCount(); i++) total += text.line(i).size();
+            if (total == 0) throw std::runtime_error("Empty script");
+        });
+    }
+}
+
+void benchSaves(BenchRunner& runner, const std::string& directory) {
+    std::unique_ptr<Module> module(createModule());
+    SaveModule* saves = dynamic_cast<SaveModule*>(module.get());
+    QSettings settings(QString::fromStdString(directory + "/bench_saves.cfg"), QSettings::IniFormat);
+    settings.setValue("Settings/DatabaseName", "bench_savegame.db");
+    settings.setValue("Settings/SavePath", QString::fromStdString(directory));
+    if (!saves || !saves->init(settings)) {
+        std::cerr << "Skipping saves benchmarks: module initialization failed\n";
+        return;
+    }
+
+    for (size_t size : {256u, 16u * 1024u, 1024u * 1024u}) {
+        std::string payload(size, 'x');
+        std::string suffix = "/" + std::to_string(size);
+        runner.run("saves/save" + suffix, 1.0, 2000, [&] {
+            if (!saves->save(payload)) throw std::runtime_error("Save failed");
+        });
+        runner.run("saves/load" + suffix, 1.0, 2000, [&] {
+            if (saves->load().size() != size) throw std::runtime_error("Load returned unexpected data");
+        });
+    }
+    saves->shutdown();
+}
+
+void benchBackend(BenchRunner& runner, const std::string& backend) {
+    // Отдельный модуль на каждый размер, чтобы загруженные ранее текстуры не влияли на замер
+    const std::pair<int, int> uploadSizes[] = {{256, 256}, {1024, 1024}, {1920, 1080}};
+    for (const auto& [width, height] : uploadSizes) {
+        std::string name = "upload/" + backend + "/" + std::to_string(width) + "x" + std::to_string(height);
+        if (!runner.enabled(name)) continue;
+        auto module = createBackend(backend);
+        RenderContext context;
+        module->init(context);
+        SDL_Surface* surface = createTestSurface(width, height, 7);
+        int counter = 0;
+        const std::vector<DisplayImage> emptyFrame;
+        // Загрузка считается завершённой, когда текстура готова к отрисовке: пустые кадры
+        // отправляют записанную передачу и забирают её после завершения на GPU
+        runner.run(name, 1.0, 32, [&] {
+            module->loadImage("upload_" + std::to_string(counter++), surface);
+            do {
+                module->render(emptyFrame);
+            } while (module->hasPendingUploads());
+        });
+        SDL_FreeSurface(surface);
+        module->cleanup();
+    }
+
+    auto module = createBackend(backend);
+    RenderContext context;
+    module->init(context);
+    const int textureCount = 8;
+    std::vector<TextureHandle> sprites;
+    for (int i = 0; i < textureCount; i++) {
+        SDL_Surface* surface = createTestSurface(256, 256, i);
+        sprites.push_back(module->loadImage("sprite_" + std::to_string(i), surface));
+        SDL_FreeSurface(surface);
+    }
+
+    for (int count : {1, 16, 64, 256, 1024}) {
+        std::vector<DisplayImage> images;
+        std::mt19937 rng(count);
+        for (int i = 0; i < count; i++) {
+            images.push_back({"sprite_" + std::to_string(i % textureCount), static_cast<int>(rng() % 1700), static_cast<int>(rng() % 860), 256, 256,
+                              sprites[i % textureCount]});
+        }
+        runner.run("draw/" + backend + "/" + std::to_string(count), static_cast<double>(count), 2000, [&] {
+            module->render(images);
+        });
+    }
+
+    // Миниатюры: спрайты с mip-уровнями, нарисованные в четыре раза меньше исходного размера
+    std::vector<TextureHandle> mipSprites;
+    for (int i = 0; i < textureCount; i++) {
+        SDL_Surface* surface = createTestSurface(256, 256, 100 + i);
+        mipSprites.push_back(module->loadImage("thumbnail_" + std::to_string(i), surface, true));
+        SDL_FreeSurface(surface);
+    }
+    std::vector<DisplayImage> thumbnails;
+    for (int i = 0; i < 256; i++) {
+        thumbnails.push_back({"thumbnail_" + std::to_string(i % textureCount), (i % 16) * 64, (i / 16) * 64, 64, 64, mipSprites[i % textureCount]});
+    }
+    runner.run("draw_scaled/" + backend + "/256", 256.0, 2000, [&] {
+        module->render(thumbnails);
+    });
+
+    // Сцена из 256 спрайтов, где первые 240 не меняются и передаются модулю одним слоем
+    std::vector<DisplayImage> scene;
+    std::mt19937 rng(256);
+    for (int i = 0; i < 256; i++) {
+        scene.push_back({"sprite_" + std::to_string(i % textureCount), static_cast<int>(rng() % 1700), static_cast<int>(rng() % 860), 256, 256,
+                         sprites[i % textureCount]});
+    }
+    RenderLayer layer;
+    layer.count = 240;
+    layer.key = 1;
+    layer.bounds = {scene[0].x, scene[0].y, scene[0].w, scene[0].h};
+    for (size_t i = 1; i < layer.count; i++) {
+        SDL_Rect rect = {scene[i].x, scene[i].y, scene[i].w, scene[i].h};
+        SDL_UnionRect(&layer.bounds, &rect, &layer.bounds);
+    }
+    std::vector<RenderLayer> layers = {layer};
+    runner.run("draw_layered/" + backend + "/256", 256.0, 2000, [&] {
+        module->renderLayers(scene, layers);
+    });
+
+    // Та же сцена, где меняется только полоса текстового окна внизу кадра
+    FrameDamage textBox;
+    textBox.full = false;
+    textBox.rects = {{0, 800, 1920, 280}};
+    runner.run("draw_partial/" + backend + "/256", 256.0, 2000, [&] {
+        module->setDamage(textBox);
+        module->render(scene);
+    });
+    if (auto* vulkan = dynamic_cast<VulkanRenderModule*>(module.get())) runner.addMemoryStats("memory/" + backend, vulkan->memoryStats());
+    module->cleanup();
+}
+
+bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--backends" && i + 1 < argc) {
+            options.backends.clear();
+            std::stringstream list(argv[++i]);
+            std::string backend;
+            while (std::getline(list, backend, ',')) options.backends.push_back(backend);
+        } else {
+            std::cerr << "Usage: vn_bench [--out results.json] [--filter substring] [--backends software,vulkan,opengl,opengl_sdl]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) return 1;
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::cerr << "Failed to create temporary directory\n";
+        return 1;
+    }
+    std::string directory = workDir.path().toStdString();
+
+    BenchRunner runner(options);
+    try {
+        benchScriptLoading(runner, directory);
+        benchSaves(runner, directory);
+        benchTextureDecoding(runner);
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << "\n";
+        return 1;
+    }
+
+    for (const auto& backend : options.backends) {
+        if (backend != "software" && SDL_WasInit(SDL_INIT_VIDEO) == 0 && SDL_Init(SDL_INIT_VIDEO) != 0) {
+            std::cerr << "Skipping " << backend << ": " << SDL_GetError() << "\n";
+            continue;
+        }
+        try {
+            benchBackend(runner, backend);
+        } catch (const std::exception& e) {
+            // GPU-бэкенды недоступны на агентах без дисплея — это не ошибка замера
+            std::cerr << "Skipping " << backend << ": " << e.what() << "\n";
+        }
+    }
+
+    if (!runner.writeJson()) {
+        std::cerr << "Failed to write " << options.outputPath << "\n";
+        return 1;
+    }
+    SDL_Quit();
+    return 0;
+}
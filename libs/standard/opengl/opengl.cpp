@@ -1,7 +1,50 @@
 #include "opengl.h"
+#include "Trace.h"
 #include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
 
-OpenGLRenderModule::OpenGLRenderModule() : renderer(nullptr), glContext(nullptr) {}
+namespace {
+
+// Спрайт переносится в более раннюю пачку той же текстуры, только если не пересекается
+// с пачками между ними; дальше этого числа пачек назад поиск не идёт
+const size_t MAX_BATCH_LOOKBACK = 64;
+const uint32_t NO_BATCH = UINT32_MAX;
+const uint32_t NO_LAYER = UINT32_MAX;
+const std::vector<RenderLayer> NO_LAYERS;
+
+// Объём отдельной текстуры RGBA8; цепочка mip-уровней добавляет около трети
+size_t textureBytes(int w, int h, bool mipmaps) {
+    size_t bytes = static_cast<size_t>(w) * h * 4;
+    return mipmaps ? bytes + bytes / 3 : bytes;
+}
+
+const char* SPRITE_VERTEX_SHADER = R"(#version 330 core
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+uniform vec2 viewScale;
+out vec2 fragTexCoord;
+void main() {
+    gl_Position = vec4(inPosition * viewScale + vec2(-1.0, 1.0), 0.0, 1.0);
+    fragTexCoord = inTexCoord;
+}
+)";
+
+const char* SPRITE_FRAGMENT_SHADER = R"(#version 330 core
+in vec2 fragTexCoord;
+uniform sampler2D spriteTexture;
+out vec4 outColor;
+void main() {
+    outColor = texture(spriteTexture, fragTexCoord);
+}
+)";
+
+} // namespace
+
+OpenGLRenderModule::OpenGLRenderModule(const OpenGLSettings& settings)
+    : settings(settings), renderer(nullptr), glContext(nullptr),
+      residency(static_cast<size_t>(settings.textureBudgetMB) * 1024 * 1024), layerCache(settings.maxCachedLayers) {}
 
 OpenGLRenderModule::~OpenGLRenderModule() {
     cleanup();
@@ -22,42 +65,750 @@ bool OpenGLRenderModule::init(RenderContext& ctx) {
         return false;
     }
 
+    if (settings.nativeRenderer) {
+        try {
+            initNative();
+            return true;
+        } catch (const std::exception& e) {
+            // Драйверы без GL 3.3 core продолжают работать через SDL_Renderer
+            std::cerr << "Native OpenGL renderer unavailable: " << e.what() << ", falling back to SDL_Renderer\n";
+            destroyNative();
+        }
+    }
+
+    // SDL_Renderer сам выбирает версию и профиль контекста
+    SDL_GL_ResetAttributes();
+
     // Создание рендера
-    renderer = SDL_CreateRenderer(context.window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    Uint32 flags = SDL_RENDERER_ACCELERATED | (settings.vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+    renderer = SDL_CreateRenderer(context.window, -1, flags);
     if (!renderer) {
         throw std::runtime_error("Failed to create SDL renderer: " + std::string(SDL_GetError()));
         return false;
     }
+    auto channel = [](float value) { return static_cast<Uint8>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    SDL_SetRenderDrawColor(renderer, channel(settings.clearColor[0]), channel(settings.clearColor[1]),
+                           channel(settings.clearColor[2]), channel(settings.clearColor[3]));
+
+    return true;
+}
 
+void OpenGLRenderModule::initNative() {
     // Создание контекста OpenGL
     glContext = SDL_GL_CreateContext(context.window);
     if (!glContext) {
         throw std::runtime_error("Failed to create OpenGL context: " + std::string(SDL_GetError()));
-        return false;
     }
 
     // Загрузка GLAD
     if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress)) {
         throw std::runtime_error("Failed to initialize GLAD");
-        return false;
     }
+    if (!GLAD_GL_VERSION_3_3) {
+        throw std::runtime_error("OpenGL 3.3 is not supported");
+    }
+    SDL_GL_SetSwapInterval(settings.vsync ? 1 : 0);
+
+    // Шейдеры удаляются сразу после присоединения и освобождаются вместе с программой
+    program = glCreateProgram();
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, SPRITE_VERTEX_SHADER);
+    glAttachShader(program, vertexShader);
+    glDeleteShader(vertexShader);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, SPRITE_FRAGMENT_SHADER);
+    glAttachShader(program, fragmentShader);
+    glDeleteShader(fragmentShader);
+    glLinkProgram(program);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[1024] = {};
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        throw std::runtime_error("Failed to link sprite program: " + std::string(log));
+    }
+    glUseProgram(program);
+    viewScaleLocation = glGetUniformLocation(program, "viewScale");
+    glUniform1i(glGetUniformLocation(program, "spriteTexture"), 0);
+
+    glGenVertexArrays(1, &vertexArray);
+#ifdef GL_ARB_buffer_storage
+    persistent = settings.persistentMapping && GLAD_GL_ARB_buffer_storage;
+#endif
+    createStreamBuffers(std::max(1u, settings.initialBatchSprites));
+
+    // Смешивание как у SDL_BLENDMODE_BLEND
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
     // Установка области просмотра
     glViewport(0, 0, 1920, 1080);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClearColor(settings.clearColor[0], settings.clearColor[1], settings.clearColor[2], settings.clearColor[3]);
 
-    return true;
+    if (settings.asyncUploads) {
+        uploadBuffers.resize(std::max(1u, settings.uploadBuffers));
+        for (auto& slot : uploadBuffers) {
+            glGenBuffers(1, &slot.buffer);
+        }
+        uploadWorker = std::thread(&OpenGLRenderModule::uploadWorkerLoop, this);
+    }
+
+    native = true;
+}
+
+void OpenGLRenderModule::destroyNative() {
+    // Без контекста объектов OpenGL нет, а функции GLAD могут быть не загружены
+    if (glContext) {
+        stopUploads();
+        if (!glTextures.empty()) glDeleteTextures(static_cast<GLsizei>(glTextures.size()), glTextures.data());
+        if (!glAtlasPages.empty()) glDeleteTextures(static_cast<GLsizei>(glAtlasPages.size()), glAtlasPages.data());
+        for (auto& target : layerTargets) {
+            destroyRenderTarget(target);
+        }
+        destroyRenderTarget(canvas);
+        destroyStreamBuffers();
+        if (vertexArray) glDeleteVertexArrays(1, &vertexArray);
+        if (program) glDeleteProgram(program);
+        SDL_GL_DeleteContext(glContext);
+        glContext = nullptr;
+    }
+    glTextures.clear();
+    glTexturePending.clear();
+    glAtlasPages.clear();
+    layerTargets.clear();
+    layerCache.clear();
+    canvas = {};
+    canvasValid = false;
+    vertexArray = 0;
+    program = 0;
+    viewScaleLocation = -1;
+    persistent = false;
+    native = false;
+}
+
+GLuint OpenGLRenderModule::compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[1024] = {};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        glDeleteShader(shader);
+        throw std::runtime_error("Failed to compile sprite shader: " + std::string(log));
+    }
+    return shader;
+}
+
+void OpenGLRenderModule::createStreamBuffers(uint32_t capacity) {
+    spriteCapacity = capacity;
+    glBindVertexArray(vertexArray);
+
+    // Индексы неизменны: спрайт i — вершины 4i..4i+3, смещение секции задаёт базовая вершина
+    std::vector<GLuint> indices(static_cast<size_t>(capacity) * 6);
+    for (uint32_t i = 0; i < capacity; i++) {
+        GLuint base = i * 4;
+        GLuint* quad = indices.data() + static_cast<size_t>(i) * 6;
+        quad[0] = base;
+        quad[1] = base + 1;
+        quad[2] = base + 2;
+        quad[3] = base + 2;
+        quad[4] = base + 3;
+        quad[5] = base;
+    }
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    GLsizeiptr sectionBytes = static_cast<GLsizeiptr>(capacity) * 4 * sizeof(GLSpriteVertex);
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+#ifdef GL_ARB_buffer_storage
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, sectionBytes * STREAM_SECTIONS, nullptr, flags);
+        persistentVertices = static_cast<GLSpriteVertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, sectionBytes * STREAM_SECTIONS, flags));
+        if (!persistentVertices) {
+            // Хранилище буфера неизменяемо, поэтому для переотвязки нужен новый буфер
+            std::cerr << "Failed to map persistent vertex buffer, orphaning it every frame instead\n";
+            glDeleteBuffers(1, &vertexBuffer);
+            glGenBuffers(1, &vertexBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            persistent = false;
+        }
+    }
+#endif
+    if (!persistent) {
+        glBufferData(GL_ARRAY_BUFFER, sectionBytes, nullptr, GL_STREAM_DRAW);
+    }
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLSpriteVertex), reinterpret_cast<void*>(offsetof(GLSpriteVertex, pos)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLSpriteVertex), reinterpret_cast<void*>(offsetof(GLSpriteVertex, uv)));
+}
+
+void OpenGLRenderModule::destroyStreamBuffers() {
+    for (uint32_t section = 0; section < STREAM_SECTIONS; section++) {
+        waitSection(section);
+    }
+    if (persistentVertices) {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        persistentVertices = nullptr;
+    }
+    if (vertexBuffer) glDeleteBuffers(1, &vertexBuffer);
+    if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+    vertexBuffer = 0;
+    indexBuffer = 0;
+    spriteCapacity = 0;
+    frameSection = 0;
+}
+
+void OpenGLRenderModule::waitSection(uint32_t section) {
+    GLsync& fence = sectionFences[section];
+    if (!fence) return;
+    // Секция свободна, когда GPU дочитал кадр, записанный в неё STREAM_SECTIONS кадров назад
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+// Текстура с параметрами выборки, без содержимого; остаётся привязанной
+GLuint OpenGLRenderModule::createGLTextureObject(bool mipmaps) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    return texture;
+}
+
+GLuint OpenGLRenderModule::createGLTexture(SDL_Surface* surface, bool mipmaps) {
+    GLuint texture = createGLTextureObject(mipmaps);
+    try {
+        updateGLTexture(texture, surface);
+    } catch (...) {
+        glDeleteTextures(1, &texture);
+        throw;
+    }
+    if (mipmaps) glGenerateMipmap(GL_TEXTURE_2D);
+    return texture;
+}
+
+void OpenGLRenderModule::updateGLTexture(GLuint texture, SDL_Surface* surface) {
+    SDL_Surface* rgba = surface->format->format == SDL_PIXELFORMAT_RGBA32
+                            ? surface
+                            : SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    if (!rgba) {
+        throw std::runtime_error("Failed to convert surface: " + std::string(SDL_GetError()));
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, rgba->pitch / 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, rgba->w, rgba->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba->pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    if (rgba != surface) SDL_FreeSurface(rgba);
+}
+
+void OpenGLRenderModule::queueUpload(TextureHandle handle, GLuint texture, SDL_Surface* surface, bool mipmaps) {
+    GLUpload upload;
+    upload.handle = handle;
+    upload.texture = texture;
+    upload.mipmaps = mipmaps;
+    // Загрузка хранит свою копию: вызывающий освобождает поверхность сразу, возможно на другом
+    // потоке, а счётчик ссылок SDL не атомарный. SDL_ConvertPixels не читает палитровые и
+    // RLE-поверхности — их конвертируем сразу, остальные копируются как есть и конвертируются в фоне
+    if (SDL_ISPIXELFORMAT_INDEXED(surface->format->format) || (surface->flags & SDL_RLEACCEL)) {
+        upload.surface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    } else {
+        upload.surface = SDL_DuplicateSurface(surface);
+    }
+    if (!upload.surface) {
+        throw std::runtime_error("Failed to copy surface: " + std::string(SDL_GetError()));
+    }
+    if (handle >= glTexturePending.size()) glTexturePending.resize(handle + 1, 0);
+    glTexturePending[handle] = 1;
+    residency.setPinned(handle, true);
+    queuedUploads.push_back(upload);
+    // Конвертация начинается сразу, не дожидаясь кадра
+    processUploads();
+}
+
+void OpenGLRenderModule::processUploads() {
+    VNE_TRACE_SCOPE("OpenGLRenderModule::processUploads");
+
+    // Копирование завершено, когда GPU прошёл забор: текстура готова, буфер свободен
+    for (size_t i = 0; i < transferringUploads.size();) {
+        GLUpload& upload = transferringUploads[i];
+        GLUploadBuffer& slot = uploadBuffers[upload.slot];
+        if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            i++;
+            continue;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        slot.busy = false;
+        glTexturePending[upload.handle] = 0;
+        residency.setPinned(upload.handle, false);
+        transferringUploads[i] = transferringUploads.back();
+        transferringUploads.pop_back();
+    }
+
+    // Сконвертированные пиксели копируются из буфера в текстуру на стороне GPU, поток не ждёт
+    std::vector<GLUpload> converted;
+    {
+        std::lock_guard<std::mutex> lock(uploadMutex);
+        converted.swap(convertedUploads);
+        uploadsInWorker -= converted.size();
+    }
+    for (auto& upload : converted) {
+        GLUploadBuffer& slot = uploadBuffers[upload.slot];
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        if (upload.failed || !intact) {
+            // Текстура остаётся без содержимого, но кадр не ломается
+            std::cerr << "Failed to upload texture " << textureNames.name(upload.handle) << "\n";
+        } else {
+            glBindTexture(GL_TEXTURE_2D, upload.texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, upload.surface->w, upload.surface->h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            if (upload.mipmaps) glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        SDL_FreeSurface(upload.surface);
+        upload.surface = nullptr;
+        upload.mapped = nullptr;
+        transferringUploads.push_back(upload);
+    }
+
+    // Ожидающие загрузки получают свободные буферы и уходят на конвертацию
+    bool queued = false;
+    for (uint32_t i = 0; i < uploadBuffers.size() && !queuedUploads.empty(); i++) {
+        GLUploadBuffer& slot = uploadBuffers[i];
+        if (slot.busy) continue;
+        GLUpload& upload = queuedUploads.front();
+        size_t bytes = static_cast<size_t>(upload.surface->w) * upload.surface->h * 4;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        if (bytes > slot.capacity) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_DRAW);
+            slot.capacity = bytes;
+        }
+        // GPU уже дочитал буфер (забор пройден), поэтому синхронизация при отображении не нужна
+        upload.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes),
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!upload.mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            throw std::runtime_error("Failed to map texture upload buffer");
+        }
+        upload.slot = i;
+        slot.busy = true;
+        {
+            std::lock_guard<std::mutex> lock(uploadMutex);
+            conversionQueue.push_back(upload);
+            uploadsInWorker++;
+        }
+        queuedUploads.pop_front();
+        queued = true;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (queued) uploadWake.notify_one();
+}
+
+void OpenGLRenderModule::uploadWorkerLoop() {
+    VNE_TRACE_THREAD_NAME("OpenGL uploads");
+    while (true) {
+        GLUpload upload;
+        {
+            std::unique_lock<std::mutex> lock(uploadMutex);
+            uploadWake.wait(lock, [this] { return uploadStopping || !conversionQueue.empty(); });
+            if (uploadStopping) return;
+            upload = conversionQueue.front();
+            conversionQueue.pop_front();
+        }
+        {
+            VNE_TRACE_SCOPE("Convert texture upload");
+            // Плотные строки RGBA8, как ждёт glTexSubImage2D при UNPACK_ROW_LENGTH = 0
+            SDL_Surface* surface = upload.surface;
+            upload.failed = SDL_ConvertPixels(surface->w, surface->h, surface->format->format, surface->pixels, surface->pitch,
+                                              SDL_PIXELFORMAT_RGBA32, upload.mapped, surface->w * 4) != 0;
+        }
+        std::lock_guard<std::mutex> lock(uploadMutex);
+        convertedUploads.push_back(upload);
+    }
+}
+
+void OpenGLRenderModule::stopUploads() {
+    if (uploadWorker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(uploadMutex);
+            uploadStopping = true;
+        }
+        uploadWake.notify_all();
+        uploadWorker.join();
+    }
+    // Незавершённые загрузки отбрасываются; отображённые буферы освобождаются при удалении
+    auto release = [](GLUpload& upload) {
+        if (upload.surface) SDL_FreeSurface(upload.surface);
+    };
+    std::for_each(queuedUploads.begin(), queuedUploads.end(), release);
+    std::for_each(conversionQueue.begin(), conversionQueue.end(), release);
+    std::for_each(convertedUploads.begin(), convertedUploads.end(), release);
+    for (auto& slot : uploadBuffers) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.buffer) glDeleteBuffers(1, &slot.buffer);
+    }
+    uploadBuffers.clear();
+    queuedUploads.clear();
+    transferringUploads.clear();
+    conversionQueue.clear();
+    convertedUploads.clear();
+    uploadsInWorker = 0;
+    uploadStopping = false;
+}
+
+bool OpenGLRenderModule::hasPendingUploads() const {
+    if (!queuedUploads.empty() || !transferringUploads.empty()) return true;
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    return uploadsInWorker > 0;
+}
+
+void OpenGLRenderModule::uploadAtlasPagesNative() {
+    int pageSize = atlas.getPageSize();
+    for (uint32_t page = 0; page < atlas.pageCount(); page++) {
+        SDL_Rect rect;
+        if (!atlas.takeDirtyRect(page, rect)) continue;
+        if (page >= glAtlasPages.size()) {
+            GLuint texture = 0;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, pageSize, pageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glAtlasPages.push_back(texture);
+        }
+        // Выгружается только изменённая область страницы
+        const uint32_t* pixels = atlas.pagePixels(page) + static_cast<size_t>(rect.y) * pageSize + rect.x;
+        glBindTexture(GL_TEXTURE_2D, glAtlasPages[page]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, pageSize);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+}
+
+// Текстура изображения и его область в ней; 0 — рисовать нечего
+GLuint OpenGLRenderModule::spriteTexture(TextureHandle handle, float uv[4]) const {
+    if (const AtlasRegion* region = atlas.find(handle)) {
+        if (region->page >= glAtlasPages.size()) return 0;
+        uv[0] = region->u0;
+        uv[1] = region->v0;
+        uv[2] = region->u1;
+        uv[3] = region->v1;
+        return glAtlasPages[region->page];
+    }
+    uv[0] = 0.0f;
+    uv[1] = 0.0f;
+    uv[2] = 1.0f;
+    uv[3] = 1.0f;
+    if (handle >= glTextures.size()) return 0;
+    // Текстура, загрузка которой не завершилась, пропускается, а не рисуется пустой
+    if (handle < glTexturePending.size() && glTexturePending[handle]) return 0;
+    return glTextures[handle];
+}
+
+// Кэшируются только слои, все изображения которых уже можно рисовать: иначе в текстуру слоя
+// попал бы кадр без них
+void OpenGLRenderModule::prepareLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) {
+    readyLayers.clear();
+    imageLayers.assign(images.size(), NO_LAYER);
+    if (!layerCache.enabled()) return;
+
+    SDL_Rect window = {0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight)};
+    float uv[4];
+    for (const auto& layer : layers) {
+        if (layer.first + layer.count > images.size()) continue;
+        RenderLayer visible = layer;
+        if (!SDL_IntersectRect(&layer.bounds, &window, &visible.bounds)) continue;
+        bool ready = true;
+        for (size_t i = layer.first; i < layer.first + layer.count && ready; i++) {
+            const DisplayImage& img = images[i];
+            ready = img.texture == INVALID_TEXTURE || img.w <= 0 || img.h <= 0 || spriteTexture(img.texture, uv) != 0;
+        }
+        if (ready) readyLayers.push_back(visible);
+    }
+
+    layerCache.beginFrame(readyLayers, layerDraws, releasedLayers);
+    for (uint32_t slot : releasedLayers) {
+        destroyRenderTarget(layerTargets[slot]);
+    }
+    if (layerTargets.size() < layerCache.slotCount()) layerTargets.resize(layerCache.slotCount());
+    for (size_t k = 0; k < readyLayers.size(); k++) {
+        const LayerCache::Draw& draw = layerDraws[k];
+        if (draw.slot == LayerCache::NO_SLOT) continue;
+        if (draw.build) {
+            GLRenderTarget& target = layerTargets[draw.slot];
+            destroyRenderTarget(target);
+            createRenderTarget(target, readyLayers[k].bounds.w, readyLayers[k].bounds.h);
+        }
+        for (size_t i = readyLayers[k].first; i < readyLayers[k].first + readyLayers[k].count; i++) {
+            imageLayers[i] = static_cast<uint32_t>(k);
+        }
+    }
+}
+
+void OpenGLRenderModule::createRenderTarget(GLRenderTarget& target, int width, int height) {
+    target.texture = createGLTextureObject(false);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Offscreen framebuffer is incomplete");
+    }
+}
+
+void OpenGLRenderModule::destroyRenderTarget(GLRenderTarget& target) {
+    if (target.framebuffer) glDeleteFramebuffers(1, &target.framebuffer);
+    if (target.texture) glDeleteTextures(1, &target.texture);
+    target = {};
+}
+
+// Спрайты изображений [begin, end) в координатах цели прохода. В проходе кадра закэшированный
+// слой заменяет свои изображения одним спрайтом на месте первого из них. При частичной
+// перерисовке спрайты вне повреждённых областей отбрасываются
+void OpenGLRenderModule::addPass(const std::vector<DisplayImage>& images, size_t begin, size_t end, GLuint framebuffer, const SDL_Rect& view, bool useLayers, bool partial) {
+    GLRenderPass pass;
+    pass.framebuffer = framebuffer;
+    pass.view = view;
+    pass.layerBuild = !useLayers;
+    pass.partial = partial;
+    pass.firstSprite = sprites.size();
+    for (size_t i = begin; i < end; i++) {
+        const DisplayImage& img = images[i];
+        GLSprite sprite;
+        uint32_t layer = useLayers ? imageLayers[i] : NO_LAYER;
+        if (layer != NO_LAYER) {
+            // Строки текстуры, в которую рисовали через кадровый буфер, идут снизу вверх
+            sprite.texture = layerTargets[layerDraws[layer].slot].texture;
+            sprite.rect = readyLayers[layer].bounds;
+            sprite.uv[0] = 0.0f;
+            sprite.uv[1] = 1.0f;
+            sprite.uv[2] = 1.0f;
+            sprite.uv[3] = 0.0f;
+            sprite.premultiplied = true;
+            i = readyLayers[layer].first + readyLayers[layer].count - 1;
+        } else {
+            if (img.w <= 0 || img.h <= 0) continue;
+            sprite.texture = spriteTexture(img.texture, sprite.uv);
+            if (!sprite.texture) continue;
+            sprite.rect = {img.x, img.y, img.w, img.h};
+        }
+        if (partial) {
+            bool damaged = false;
+            for (const auto& rect : damage.rects) {
+                damaged = damaged || SDL_HasIntersection(&rect, &sprite.rect);
+            }
+            if (!damaged) continue;
+        }
+        sprite.rect.x -= view.x;
+        sprite.rect.y -= view.y;
+        sprites.push_back(sprite);
+    }
+    passes.push_back(pass);
+    buildBatches(passes.back());
+}
+
+void OpenGLRenderModule::buildBatches(GLRenderPass& pass) {
+    pass.firstBatch = batches.size();
+    spriteBatches.resize(sprites.size());
+
+    for (size_t i = pass.firstSprite; i < sprites.size(); i++) {
+        const GLSprite& sprite = sprites[i];
+
+        // Ищем пачку той же текстуры назад по проходу. Пачка другой текстуры, перекрывающая спрайт,
+        // должна остаться над ним — за неё спрайт переносить нельзя
+        uint32_t target = NO_BATCH;
+        size_t stop = batches.size() - std::min(batches.size() - pass.firstBatch, MAX_BATCH_LOOKBACK);
+        for (size_t b = batches.size(); b > stop; b--) {
+            const GLSpriteBatch& batch = batches[b - 1];
+            if (batch.texture == sprite.texture) {
+                target = static_cast<uint32_t>(b - 1);
+                break;
+            }
+            if (SDL_HasIntersection(&batch.bounds, &sprite.rect)) break;
+        }
+
+        if (target == NO_BATCH) {
+            target = static_cast<uint32_t>(batches.size());
+            GLSpriteBatch batch;
+            batch.texture = sprite.texture;
+            batch.premultiplied = sprite.premultiplied;
+            batch.bounds = sprite.rect;
+            batches.push_back(batch);
+        } else {
+            SDL_Rect merged;
+            SDL_UnionRect(&batches[target].bounds, &sprite.rect, &merged);
+            batches[target].bounds = merged;
+        }
+        batches[target].count++;
+        spriteBatches[i] = target;
+    }
+    pass.batchCount = batches.size() - pass.firstBatch;
+}
+
+void OpenGLRenderModule::renderNative(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) {
+    if (uploadWorker.joinable()) processUploads();
+    uploadAtlasPagesNative();
+    prepareLayers(images, layers);
+
+    // Сначала собираются новые слои, затем кадр; спрайты всех проходов пишутся в буфер за одно отображение
+    sprites.clear();
+    passes.clear();
+    batches.clear();
+    for (size_t k = 0; k < readyLayers.size(); k++) {
+        if (!layerDraws[k].build) continue;
+        const RenderLayer& layer = readyLayers[k];
+        addPass(images, layer.first, layer.first + layer.count, layerTargets[layerDraws[k].slot].framebuffer, layer.bounds, false, false);
+    }
+    // Задний буфер после показа не сохраняется, поэтому прошлый кадр хранится в холсте
+    SDL_Rect window = {0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight)};
+    if (settings.partialRedraw && !canvas.framebuffer) {
+        createRenderTarget(canvas, window.w, window.h);
+        canvasValid = false;
+    }
+    bool partial = canvas.framebuffer && canvasValid && !damage.full;
+    addPass(images, 0, images.size(), canvas.framebuffer, window, true, partial);
+
+    uint32_t first = 0;
+    for (auto& batch : batches) {
+        batch.first = first;
+        first += batch.count;
+    }
+    uint32_t spriteCount = static_cast<uint32_t>(sprites.size());
+    if (spriteCount > spriteCapacity) {
+        uint32_t capacity = spriteCapacity;
+        while (capacity < spriteCount) capacity *= 2;
+        destroyStreamBuffers();
+        createStreamBuffers(capacity);
+    }
+
+    GLint baseVertex = 0;
+    if (spriteCount > 0) {
+        GLSpriteVertex* vertices = nullptr;
+        if (persistent) {
+            frameSection = (frameSection + 1) % STREAM_SECTIONS;
+            waitSection(frameSection);
+            baseVertex = static_cast<GLint>(frameSection * spriteCapacity * 4);
+            vertices = persistentVertices + baseVertex;
+        } else {
+            // Переотвязка: драйвер выдаёт новое хранилище, не дожидаясь, пока GPU дочитает прошлый кадр
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(spriteCapacity) * 4 * sizeof(GLSpriteVertex), nullptr, GL_STREAM_DRAW);
+            vertices = static_cast<GLSpriteVertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(spriteCount) * 4 * sizeof(GLSpriteVertex),
+                                                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            if (!vertices) {
+                throw std::runtime_error("Failed to map streaming vertex buffer");
+            }
+        }
+
+        // Спрайты пишутся сразу на место своей пачки; внутри пачки порядок кадра сохраняется
+        batchCursors.resize(batches.size());
+        for (size_t b = 0; b < batches.size(); b++) {
+            batchCursors[b] = batches[b].first;
+        }
+        for (size_t i = 0; i < sprites.size(); i++) {
+            const GLSprite& sprite = sprites[i];
+            float x0 = static_cast<float>(sprite.rect.x);
+            float y0 = static_cast<float>(sprite.rect.y);
+            float x1 = static_cast<float>(sprite.rect.x + sprite.rect.w);
+            float y1 = static_cast<float>(sprite.rect.y + sprite.rect.h);
+            const float* uv = sprite.uv;
+            GLSpriteVertex* quad = vertices + static_cast<size_t>(batchCursors[spriteBatches[i]]++) * 4;
+            quad[0] = {{x0, y0}, {uv[0], uv[1]}};
+            quad[1] = {{x1, y0}, {uv[2], uv[1]}};
+            quad[2] = {{x1, y1}, {uv[2], uv[3]}};
+            quad[3] = {{x0, y1}, {uv[0], uv[3]}};
+        }
+        if (!persistent) glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    // Один вызов отрисовки на пачку
+    glUseProgram(program);
+    glBindVertexArray(vertexArray);
+    glActiveTexture(GL_TEXTURE0);
+    for (const auto& pass : passes) {
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+        glViewport(0, 0, pass.view.w, pass.view.h);
+        if (pass.layerBuild) glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        else glClearColor(settings.clearColor[0], settings.clearColor[1], settings.clearColor[2], settings.clearColor[3]);
+        glUniform2f(viewScaleLocation, 2.0f / pass.view.w, -2.0f / pass.view.h);
+        // Каждая повреждённая область очищается и перерисовывается под своими ножницами
+        size_t clipCount = pass.partial ? damage.rects.size() : 1;
+        if (pass.partial) glEnable(GL_SCISSOR_TEST);
+        for (size_t c = 0; c < clipCount; c++) {
+            if (pass.partial) {
+                // Ножницы считаются от нижнего края цели
+                const SDL_Rect& rect = damage.rects[c];
+                glScissor(rect.x, pass.view.h - rect.y - rect.h, rect.w, rect.h);
+            }
+            glClear(GL_COLOR_BUFFER_BIT);
+            for (size_t b = pass.firstBatch; b < pass.firstBatch + pass.batchCount; b++) {
+                const GLSpriteBatch& batch = batches[b];
+                // Цвет в текстуре слоя уже умножен на альфу при сборке
+                if (batch.premultiplied) glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                glBindTexture(GL_TEXTURE_2D, batch.texture);
+                const void* offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(batch.first) * 6 * sizeof(GLuint));
+                glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(batch.count * 6), GL_UNSIGNED_INT, offset, baseVertex);
+                if (batch.premultiplied) glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            }
+        }
+        if (pass.partial) glDisable(GL_SCISSOR_TEST);
+    }
+    if (persistent && spriteCount > 0) sectionFences[frameSection] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // Холст целиком копируется в задний буфер: его содержимое после прошлого показа не определено
+    if (canvas.framebuffer) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas.framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, window.w, window.h, 0, 0, window.w, window.h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        canvasValid = true;
+    }
+    damage = FrameDamage();
+
+    // Презентация результата
+    SDL_GL_SwapWindow(context.window);
 }
 
 void OpenGLRenderModule::render(const std::vector<DisplayImage>& images) {
+    renderLayers(images, NO_LAYERS);
+}
+
+// SDL_Renderer рисует слои как обычные изображения
+void OpenGLRenderModule::renderLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) {
+    updateResidency(images);
+    if (native) {
+        renderNative(images, layers);
+        return;
+    }
+
+    uploadAtlasPages();
+
     // Очистка экрана
     SDL_RenderClear(renderer);
 
     // Отрисовка всех изображений
     for (const auto& img : images) {
-        if (textures.find(img.name) != textures.end()) {
-            SDL_Rect rect = {img.x, img.y, img.w, img.h};
-            SDL_RenderCopy(renderer, textures[img.name], nullptr, &rect);
+        SDL_Rect rect = {img.x, img.y, img.w, img.h};
+        if (const AtlasRegion* region = atlas.find(img.texture)) {
+            SDL_Rect source = {region->x, region->y, region->w, region->h};
+            SDL_RenderCopy(renderer, atlasPages[region->page], &source, &rect);
+        } else if (img.texture < textures.size() && textures[img.texture]) {
+            SDL_RenderCopy(renderer, textures[img.texture], nullptr, &rect);
         }
     }
 
@@ -65,18 +816,32 @@ void OpenGLRenderModule::render(const std::vector<DisplayImage>& images) {
     SDL_RenderPresent(renderer);
 }
 
+void OpenGLRenderModule::detachThread() {
+    if (context.window) SDL_GL_MakeCurrent(context.window, nullptr);
+}
+
+void OpenGLRenderModule::attachThread() {
+    if (glContext && SDL_GL_MakeCurrent(context.window, glContext) != 0) {
+        throw std::runtime_error("Failed to make OpenGL context current: " + std::string(SDL_GetError()));
+    }
+}
+
 void OpenGLRenderModule::cleanup() {
     // Очистка текстур
     for (auto& texture : textures) {
-        SDL_DestroyTexture(texture.second);
+        if (texture) SDL_DestroyTexture(texture);
+    }
+    for (auto& page : atlasPages) {
+        SDL_DestroyTexture(page);
     }
     textures.clear();
+    atlasPages.clear();
+    atlas.clear();
+    residency.clear();
+    textureNames.clear();
 
     // Уничтожение контекста и рендера
-    if (glContext) {
-        SDL_GL_DeleteContext(glContext);
-        glContext = nullptr;
-    }
+    destroyNative();
     if (renderer) {
         SDL_DestroyRenderer(renderer);
         renderer = nullptr;
@@ -87,20 +852,132 @@ void OpenGLRenderModule::cleanup() {
     }
 }
 
-void OpenGLRenderModule::loadImage(const std::string& imageName, SDL_Surface* surface) {
-    if (textures.find(imageName) == textures.end()) {
+TextureHandle OpenGLRenderModule::loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps) {
+    TextureHandle handle = textureNames.intern(imageName);
+    if (native) {
+        if (handle >= glTextures.size()) glTextures.resize(handle + 1, 0);
+        // Mip-уровни строит драйвер для целой текстуры, поэтому такие изображения не идут в атлас
+        if (!glTextures[handle] && !atlas.find(handle) && (mipmaps || !atlas.insert(handle, surface))) {
+            residency.add(handle, textureBytes(surface->w, surface->h, mipmaps), true, mipmaps);
+            if (uploadWorker.joinable()) {
+                // Крупное изображение: хранилище выделяется сразу, пиксели приходят через PBO
+                GLuint texture = createGLTextureObject(mipmaps);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, surface->w, surface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glTextures[handle] = texture;
+                queueUpload(handle, texture, surface, mipmaps);
+            } else {
+                glTextures[handle] = createGLTexture(surface, mipmaps);
+            }
+        }
+        return handle;
+    }
+
+    if (handle >= textures.size()) textures.resize(handle + 1, nullptr);
+    // Мелкие изображения упаковываются в атлас и выгружаются пачкой перед отрисовкой кадра.
+    // SDL_Renderer не строит mip-уровни, поэтому уменьшаемые спрайты получают отдельную
+    // текстуру с линейной фильтрацией вместо выборки по ближайшему соседу
+    if (!textures[handle] && !atlas.find(handle) && (mipmaps || !atlas.insert(handle, surface))) {
         SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
         if (!texture) {
             throw std::runtime_error("Failed to create texture from surface: " + std::string(SDL_GetError()));
         }
-        textures[imageName] = texture;
+        if (mipmaps) SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
+        textures[handle] = texture;
+        residency.add(handle, textureBytes(surface->w, surface->h, false), true, mipmaps);
     }
+    return handle;
 }
 
-void OpenGLRenderModule::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
+TextureHandle OpenGLRenderModule::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
+    TextureHandle handle = textureNames.intern(textKey);
+    if (native) {
+        if (handle >= glTextures.size()) glTextures.resize(handle + 1, 0);
+        // Текст в атласе заменяется на месте, отдельная текстура перезаписывается без пересоздания
+        if (glTextures[handle]) {
+            updateGLTexture(glTextures[handle], surface);
+        } else if (!atlas.insert(handle, surface)) {
+            glTextures[handle] = createGLTexture(surface, false);
+        } else {
+            return handle;
+        }
+        residency.add(handle, textureBytes(surface->w, surface->h, false), false);
+        return handle;
+    }
+
+    if (handle >= textures.size()) textures.resize(handle + 1, nullptr);
+    if (!textures[handle] && atlas.insert(handle, surface)) {
+        return handle;
+    }
     SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, surface);
     if (!textTexture) {
         throw std::runtime_error("Failed to create text texture: " + std::string(SDL_GetError()));
     }
-    textures[textKey] = textTexture;
-}
\ No newline at end of file
+    // Прежняя текстура этого текста больше не нужна
+    if (textures[handle]) SDL_DestroyTexture(textures[handle]);
+    textures[handle] = textTexture;
+    residency.add(handle, textureBytes(surface->w, surface->h, false), false);
+    return handle;
+}
+
+void OpenGLRenderModule::updateResidency(const std::vector<DisplayImage>& images) {
+    residency.beginFrame();
+    for (const auto& img : images) {
+        if (residency.isEvicted(img.texture)) reloadTexture(img.texture);
+        residency.touch(img.texture);
+    }
+    // Драйвер сам дожидается кадров, которые ещё читают удаляемую текстуру
+    residency.collect(evictedTextures);
+    for (TextureHandle handle : evictedTextures) {
+        releaseTexture(handle);
+    }
+}
+
+// Вытесненное изображение загружается снова тем же путём, что и в первый раз
+void OpenGLRenderModule::reloadTexture(TextureHandle handle) {
+    const std::string& name = textureNames.name(handle);
+    DecodedImage image = textureSource ? textureSource(name) : DecodedImage();
+    if (!image) {
+        std::cerr << "Failed to reload evicted texture " << name << "\n";
+        residency.reloadFailed(handle);
+        return;
+    }
+    if (image.compressed) {
+        loadCompressedImage(name, *image.compressed);
+    } else {
+        loadImage(name, image.surface, residency.hasMipmaps(handle));
+        SDL_FreeSurface(image.surface);
+    }
+    // Если место нашлось в атласе, отдельная текстура больше не учитывается
+    if (residency.isEvicted(handle)) residency.remove(handle);
+}
+
+void OpenGLRenderModule::releaseTexture(TextureHandle handle) {
+    if (handle < glTextures.size() && glTextures[handle]) {
+        glDeleteTextures(1, &glTextures[handle]);
+        glTextures[handle] = 0;
+    }
+    if (handle < textures.size() && textures[handle]) {
+        SDL_DestroyTexture(textures[handle]);
+        textures[handle] = nullptr;
+    }
+}
+void OpenGLRenderModule::uploadAtlasPages() {
+    int pageSize = atlas.getPageSize();
+    for (uint32_t page = 0; page < atlas.pageCount(); page++) {
+        SDL_Rect rect;
+        if (!atlas.takeDirtyRect(page, rect)) continue;
+        if (page >= atlasPages.size()) {
+            SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, pageSize, pageSize);
+            if (!texture) {
+                throw std::runtime_error("Failed to create atlas texture: " + std::string(SDL_GetError()));
+            }
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            atlasPages.push_back(texture);
+        }
+        // Выгружается только изменённая область страницы
+        const uint32_t* pixels = atlas.pagePixels(page) + static_cast<size_t>(rect.y) * pageSize + rect.x;
+        if (SDL_UpdateTexture(atlasPages[page], &rect, pixels, pageSize * 4) != 0) {
+            throw std::runtime_error("Failed to update atlas texture: " + std::string(SDL_GetError()));
+        }
+    }
+}
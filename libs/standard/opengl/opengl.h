@@ -3,24 +3,204 @@
 
 #include <SDL2/SDL.h>
 #include "files/include/glad/glad.h"
-#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "TextureRegistry.h"
+#include "TextureAtlas.h"
+#include "TextureResidency.h"
+#include "LayerCache.h"
+#include "DamageTracker.h"
+
+// Настройки из opengl.cfg
+struct OpenGLSettings {
+    bool nativeRenderer = true;           // Пакетный рендерер на шейдерах; false или ошибка инициализации — SDL_Renderer
+    bool persistentMapping = true;        // Постоянно отображённый буфер вершин (ARB_buffer_storage), иначе — переотвязка буфера
+    uint32_t initialBatchSprites = 4096;  // Начальная ёмкость потокового буфера; растёт по необходимости
+    uint32_t textureBudgetMB = 512;       // Предел отдельных текстур в видеопамяти; 0 — без ограничения
+    bool asyncUploads = true;             // Крупные изображения конвертируются в фоне и загружаются через PBO
+    uint32_t uploadBuffers = 4;           // Кольцо PBO: сколько загрузок идёт одновременно
+    uint32_t maxCachedLayers = 4;         // Текстур для слоёв, найденных движком; 0 — слои рисуются как обычно
+    bool partialRedraw = true;            // Кадр хранится в текстуре-холсте, перерисовываются только изменившиеся области
+    bool vsync = true;
+    float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+};
+
+// Вершина спрайта в пикселях окна; перевод в NDC делает вершинный шейдер
+struct GLSpriteVertex {
+    float pos[2];
+    float uv[2];
+};
+
+// Спрайт кадра: прямоугольник в координатах цели прохода и область текстуры
+struct GLSprite {
+    GLuint texture = 0;
+    SDL_Rect rect = {0, 0, 0, 0};
+    float uv[4] = {0.0f, 0.0f, 1.0f, 1.0f}; // u0, v0, u1, v1
+    bool premultiplied = false; // Текстура слоя: цвет уже умножен на альфу
+};
+
+// Спрайты одной текстуры, рисуемые одним вызовом; bounds — объединение их прямоугольников на экране
+struct GLSpriteBatch {
+    GLuint texture = 0;
+    bool premultiplied = false;
+    SDL_Rect bounds = {0, 0, 0, 0};
+    uint32_t first = 0; // Первый спрайт пачки в буфере кадра
+    uint32_t count = 0;
+};
+
+// Проход кадра: сборка слоя в его текстуру или вывод кадра (на экран или в холст)
+struct GLRenderPass {
+    GLuint framebuffer = 0;
+    SDL_Rect view = {0, 0, 0, 0}; // Область окна, которую покрывает цель
+    bool layerBuild = false;      // Слой собирается на прозрачном фоне
+    bool partial = false;         // Перерисовываются только повреждённые области холста
+    size_t firstSprite = 0;
+    size_t firstBatch = 0;
+    size_t batchCount = 0;
+};
+
+// Текстура с кадровым буфером: цель закэшированного слоя или холст кадра
+struct GLRenderTarget {
+    GLuint texture = 0;
+    GLuint framebuffer = 0;
+};
+
+// Буфер распаковки из кольца загрузок; занят, пока GPU не прочитал его (забор fence)
+struct GLUploadBuffer {
+    GLuint buffer = 0;
+    size_t capacity = 0;
+    GLsync fence = nullptr;
+    bool busy = false;
+};
+
+// Асинхронная загрузка отдельной текстуры: ожидание буфера -> конвертация в фоне -> копирование из PBO
+struct GLUpload {
+    TextureHandle handle = INVALID_TEXTURE;
+    GLuint texture = 0;
+    SDL_Surface* surface = nullptr; // Своя копия поверхности; освобождается на потоке OpenGL
+    bool mipmaps = false;
+    uint32_t slot = UINT32_MAX;     // Буфер из кольца
+    void* mapped = nullptr;         // Отображение буфера, в которое пишет поток конвертации
+    bool failed = false;
+};
 
 class OpenGLRenderModule : public IRenderModule {
 private:
+    static const uint32_t STREAM_SECTIONS = 3; // Секции постоянно отображённого буфера: CPU пишет одну, GPU читает другие
+
+    OpenGLSettings settings;
     SDL_Renderer* renderer;
     SDL_GLContext glContext;
-    std::map<std::string, SDL_Texture*> textures;
+    TextureRegistry textureNames;
+    std::vector<SDL_Texture*> textures; // Индексируется TextureHandle; nullptr для изображений из атласа
+    TextureAtlas atlas;
+    std::vector<SDL_Texture*> atlasPages;
     RenderContext context;
+    TextureResidency residency;
+    TextureSource textureSource;
+    std::vector<TextureHandle> evictedTextures;
+
+    // Собственный рендерер
+    bool native = false;
+    std::vector<GLuint> glTextures;     // Индексируется TextureHandle; 0 для изображений из атласа
+    std::vector<GLuint> glAtlasPages;
+    GLuint program = 0;
+    GLint viewScaleLocation = -1;
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    uint32_t spriteCapacity = 0;        // Спрайтов в одной секции потокового буфера
+    bool persistent = false;
+    GLSpriteVertex* persistentVertices = nullptr;
+    GLsync sectionFences[STREAM_SECTIONS] = {};
+    uint32_t frameSection = 0;
+    std::vector<GLSprite> sprites;       // Спрайты всех проходов кадра подряд
+    std::vector<GLRenderPass> passes;
+    std::vector<GLSpriteBatch> batches;
+    std::vector<uint32_t> spriteBatches; // Пачка каждого спрайта
+    std::vector<uint32_t> batchCursors;
+
+    // Кэш слоёв: readyLayers — слои кадра, все изображения которых можно рисовать
+    LayerCache layerCache;
+    std::vector<GLRenderTarget> layerTargets; // Индексируется ячейкой LayerCache
+    std::vector<RenderLayer> readyLayers;
+    std::vector<LayerCache::Draw> layerDraws;
+    std::vector<uint32_t> releasedLayers;
+    std::vector<uint32_t> imageLayers;   // Слой каждого изображения кадра из readyLayers; UINT32_MAX — вне слоёв
+    std::vector<uint8_t> glTexturePending; // Индексируется TextureHandle; 1 — загрузка ещё не завершена
+
+    // Частичная перерисовка: холст переживает кадр, damage задаёт движок перед render
+    GLRenderTarget canvas;
+    bool canvasValid = false; // В холсте лежит прошлый кадр
+    FrameDamage damage;
+
+    // Асинхронные загрузки. Вызовы OpenGL — только на потоке рендеринга, фоновый поток лишь
+    // конвертирует пиксели в отображённую память буфера
+    std::vector<GLUploadBuffer> uploadBuffers;
+    std::deque<GLUpload> queuedUploads;     // Ждут свободного буфера
+    std::vector<GLUpload> transferringUploads; // Копирование из буфера в текстуру отправлено
+    std::thread uploadWorker;
+    mutable std::mutex uploadMutex;
+    std::condition_variable uploadWake;
+    std::deque<GLUpload> conversionQueue;   // Под uploadMutex
+    std::vector<GLUpload> convertedUploads; // Под uploadMutex
+    size_t uploadsInWorker = 0;             // Под uploadMutex: в очереди, в работе и готовые
+    bool uploadStopping = false;
+    const float windowWidth = 1920.0f;
+    const float windowHeight = 1080.0f;
+
+    void uploadAtlasPages();
+    void updateResidency(const std::vector<DisplayImage>& images);
+    void reloadTexture(TextureHandle handle);
+    void releaseTexture(TextureHandle handle);
+    void initNative();
+    void destroyNative();
+    GLuint compileShader(GLenum type, const char* source);
+    void createStreamBuffers(uint32_t capacity);
+    void destroyStreamBuffers();
+    void waitSection(uint32_t section);
+    GLuint createGLTexture(SDL_Surface* surface, bool mipmaps);
+    void updateGLTexture(GLuint texture, SDL_Surface* surface);
+    void uploadAtlasPagesNative();
+    GLuint spriteTexture(TextureHandle handle, float uv[4]) const;
+    void prepareLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers);
+    void createRenderTarget(GLRenderTarget& target, int width, int height);
+    void destroyRenderTarget(GLRenderTarget& target);
+    void addPass(const std::vector<DisplayImage>& images, size_t begin, size_t end, GLuint framebuffer, const SDL_Rect& view, bool useLayers, bool partial);
+    void buildBatches(GLRenderPass& pass);
+    void renderNative(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers);
+    GLuint createGLTextureObject(bool mipmaps);
+    void queueUpload(TextureHandle handle, GLuint texture, SDL_Surface* surface, bool mipmaps);
+    void processUploads();
+    void uploadWorkerLoop();
+    void stopUploads();
 
 public:
-    OpenGLRenderModule();
+    explicit OpenGLRenderModule(const OpenGLSettings& settings = OpenGLSettings());
     ~OpenGLRenderModule() override;
 
     bool init(RenderContext& context) override;
     void render(const std::vector<DisplayImage>& images) override;
+    void renderLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) override;
     void cleanup() override;
-    void loadImage(const std::string& imageName, SDL_Surface* surface) override;
-    void renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) override;
+    TextureHandle loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps = false) override;
+    TextureHandle renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) override;
+    void setTextureSource(TextureSource source) override { textureSource = std::move(source); }
+    ResidencyStats residencyStats() const override { return residency.stats(); }
+    LayerCacheStats layerCacheStats() const override { return layerCache.stats(); }
+    SDL_Point outputSize() const override { return {static_cast<int>(windowWidth), static_cast<int>(windowHeight)}; }
+    void setDamage(const FrameDamage& frameDamage) override { damage = frameDamage; }
+    bool hasPendingUploads() const override;
+    // Контекст OpenGL текущий только на одном потоке; SDL_Renderer сам делает свой контекст текущим
+    void detachThread() override;
+    void attachThread() override;
+    // Работает ли собственный рендерер (false — запасной путь через SDL_Renderer)
+    bool isNative() const { return native; }
 };
 
 #endif // OPENGL_RENDER_MODULE_H
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "software.h"
+#include <stdexcept>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_RENDER_SSE2 1
+#endif
+
+namespace {
+
+// Точное деление на 255 с округлением для значений до 255 * 255
+inline uint32_t div255(uint32_t value) {
+    value += 128;
+    return (value + (value >> 8)) >> 8;
+}
+
+inline uint32_t blendPixel(uint32_t dst, uint32_t src) {
+    uint32_t alpha = src >> 24;
+    if (alpha == 255) return src;
+    if (alpha == 0 && src == 0) return dst;
+    uint32_t inverse = 255 - alpha;
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t channel = ((src >> shift) & 0xFF) + div255(((dst >> shift) & 0xFF) * inverse);
+        result |= std::min<uint32_t>(channel, 255) << shift;
+    }
+    return result;
+}
+
+#ifdef SOFTWARE_RENDER_SSE2
+// Четыре пикселя за итерацию: каналы расширяются до 16 бит, умножаются на (255 - srcA) и делятся на 255
+inline __m128i blendPixels4(__m128i dst, __m128i src) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i inverse = _mm_sub_epi32(_mm_set1_epi32(255), _mm_srli_epi32(src, 24));
+    inverse = _mm_or_si128(inverse, _mm_slli_epi32(inverse, 16));
+    __m128i inverseLo = _mm_unpacklo_epi32(inverse, inverse);
+    __m128i inverseHi = _mm_unpackhi_epi32(inverse, inverse);
+
+    __m128i dstLo = _mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inverseLo);
+    __m128i dstHi = _mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inverseHi);
+    dstLo = _mm_add_epi16(dstLo, bias);
+    dstHi = _mm_add_epi16(dstHi, bias);
+    dstLo = _mm_srli_epi16(_mm_add_epi16(dstLo, _mm_srli_epi16(dstLo, 8)), 8);
+    dstHi = _mm_srli_epi16(_mm_add_epi16(dstHi, _mm_srli_epi16(dstHi, 8)), 8);
+
+    return _mm_adds_epu8(src, _mm_packus_epi16(dstLo, dstHi));
+}
+#endif
+
+bool writePPM(const std::string& path, const uint32_t* pixels, int width, int height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+    for (int y = 0; y < height; y++) {
+        const uint32_t* src = pixels + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = static_cast<uint8_t>(src[x]);
+            row[x * 3 + 1] = static_cast<uint8_t>(src[x] >> 8);
+            row[x * 3 + 2] = static_cast<uint8_t>(src[x] >> 16);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return file.good();
+}
+
+} // namespace
+
+void blendRow(uint32_t* dst, const uint32_t* src, int count) {
+    int x = 0;
+#ifdef SOFTWARE_RENDER_SSE2
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    for (; x + 4 <= count; x += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i alpha = _mm_and_si128(s, alphaMask);
+        // Быстрые пути для непрозрачных и полностью прозрачных блоков
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xFFFF) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), s);
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, _mm_setzero_si128())) == 0xFFFF) continue;
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), blendPixels4(d, s));
+    }
+#endif
+    for (; x < count; x++) {
+        dst[x] = blendPixel(dst[x], src[x]);
+    }
+}
+
+void downsampleRow(uint32_t* dst, const uint32_t* row0, const uint32_t* row1, int srcWidth, int dstWidth) {
+    int x = 0;
+#ifdef SOFTWARE_RENDER_SSE2
+    // Два пикселя назначения за итерацию: четыре исходных из каждой строки складываются в 16-битных каналах
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(2);
+    for (; x + 2 <= dstWidth && 2 * x + 4 <= srcWidth; x += 2) {
+        __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x));
+        __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x));
+        __m128i sumLo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+        __m128i sumHi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+        sumLo = _mm_add_epi16(sumLo, _mm_srli_si128(sumLo, 8));
+        sumHi = _mm_add_epi16(sumHi, _mm_srli_si128(sumHi, 8));
+        __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sumLo, sumHi), bias), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sum, zero));
+    }
+#endif
+    for (; x < dstWidth; x++) {
+        int x0 = 2 * x;
+        int x1 = std::min(x0 + 1, srcWidth - 1);
+        uint32_t result = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t sum = ((row0[x0] >> shift) & 0xFF) + ((row0[x1] >> shift) & 0xFF) +
+                           ((row1[x0] >> shift) & 0xFF) + ((row1[x1] >> shift) & 0xFF);
+            result |= ((sum + 2) >> 2) << shift;
+        }
+        dst[x] = result;
+    }
+}
+
+SoftwareRenderModule::SoftwareRenderModule(const SoftwareSettings& settings) : settings(settings) {}
+
+SoftwareRenderModule::~SoftwareRenderModule() {
+    cleanup();
+}
+
+bool SoftwareRenderModule::init(RenderContext& ctx) {
+    context = ctx;
+    if (settings.width <= 0 || settings.height <= 0) {
+        throw std::runtime_error("Invalid software framebuffer size");
+    }
+    framebuffer.assign(static_cast<size_t>(settings.width) * settings.height, settings.clearColor);
+    rowBuffer.resize(settings.width);
+    frameIndex = 0;
+    return true;
+}
+
+SoftwareImage SoftwareRenderModule::convertSurface(SDL_Surface* surface) {
+    SDL_Surface* rgba = surface;
+    if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+        rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        if (!rgba) {
+            throw std::runtime_error("Failed to convert surface: " + std::string(SDL_GetError()));
+        }
+    }
+
+    SoftwareImage image;
+    image.width = rgba->w;
+    image.height = rgba->h;
+    image.pixels.resize(static_cast<size_t>(rgba->w) * rgba->h);
+    for (int y = 0; y < rgba->h; y++) {
+        const uint8_t* row = static_cast<const uint8_t*>(rgba->pixels) + static_cast<size_t>(y) * rgba->pitch;
+        uint32_t* out = image.pixels.data() + static_cast<size_t>(y) * rgba->w;
+        std::memcpy(out, row, static_cast<size_t>(rgba->w) * 4);
+        // Предумножение альфы один раз при загрузке экономит умножение на каждом кадре
+        for (int x = 0; x < rgba->w; x++) {
+            uint32_t pixel = out[x];
+            uint32_t alpha = pixel >> 24;
+            if (alpha == 255) continue;
+            out[x] = (alpha << 24) | (div255(((pixel >> 16) & 0xFF) * alpha) << 16) |
+                     (div255(((pixel >> 8) & 0xFF) * alpha) << 8) | div255((pixel & 0xFF) * alpha);
+        }
+    }
+
+    if (rgba != surface) SDL_FreeSurface(rgba);
+    return image;
+}
+
+// Пиксели предумножены, поэтому простое среднее не даёт тёмной каймы на краях прозрачности
+void SoftwareRenderModule::buildMips(SoftwareImage& image) {
+    const SoftwareImage* previous = &image;
+    std::vector<SoftwareImage> mips;
+    while (previous->width > 1 || previous->height > 1) {
+        SoftwareImage level;
+        level.width = std::max(1, previous->width / 2);
+        level.height = std::max(1, previous->height / 2);
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height);
+        for (int y = 0; y < level.height; y++) {
+            const uint32_t* row0 = previous->pixels.data() + static_cast<size_t>(2 * y) * previous->width;
+            const uint32_t* row1 = previous->pixels.data() + static_cast<size_t>(std::min(2 * y + 1, previous->height - 1)) * previous->width;
+            downsampleRow(level.pixels.data() + static_cast<size_t>(y) * level.width, row0, row1, previous->width, level.width);
+        }
+        mips.push_back(std::move(level));
+        previous = &mips.back();
+    }
+    image.mips = std::move(mips);
+}
+
+// clip — часть кадра, которую разрешено менять
+void SoftwareRenderModule::drawImage(const SoftwareImage& sourceImage, int x, int y, int w, int h, const SDL_Rect& clip) {
+    if (w <= 0 || h <= 0 || sourceImage.width == 0 || sourceImage.height == 0) return;
+
+    // При уменьшении берётся самый мелкий уровень, который ещё не меньше области на экране
+    const SoftwareImage* level = &sourceImage;
+    for (const auto& mip : sourceImage.mips) {
+        if (mip.width < w || mip.height < h) break;
+        level = &mip;
+    }
+    const SoftwareImage& image = *level;
+
+    int x0 = std::max(x, clip.x);
+    int y0 = std::max(y, clip.y);
+    int x1 = std::min(x + w, clip.x + clip.w);
+    int y1 = std::min(y + h, clip.y + clip.h);
+    if (x0 >= x1 || y0 >= y1) return;
+    int spanWidth = x1 - x0;
+
+    // Масштабирование по ближайшему соседу, скалярное: в SSE2 нет выборки по индексам. Таблица столбцов
+    // зависит только от ширины исходника и назначения, поэтому строится заново только при их смене
+    bool scaledX = w != image.width;
+    if (scaledX && (columnMapSource != image.width || columnMapWidth != w)) {
+        columnMap.resize(w);
+        int64_t step = (static_cast<int64_t>(image.width) << 16) / w;
+        for (int i = 0; i < w; i++) {
+            columnMap[i] = static_cast<int>((i * step) >> 16);
+        }
+        columnMapSource = image.width;
+        columnMapWidth = w;
+    }
+    const int* columns = scaledX ? columnMap.data() + (x0 - x) : nullptr;
+
+    for (int row = y0; row < y1; row++) {
+        int srcY = static_cast<int>(static_cast<int64_t>(row - y) * image.height / h);
+        const uint32_t* srcRow = image.pixels.data() + static_cast<size_t>(srcY) * image.width;
+        const uint32_t* src = srcRow + (x0 - x);
+        if (scaledX) {
+            for (int i = 0; i < spanWidth; i++) rowBuffer[i] = srcRow[columns[i]];
+            src = rowBuffer.data();
+        }
+        blendRow(framebuffer.data() + static_cast<size_t>(row) * settings.width + x0, src, spanWidth);
+    }
+}
+
+void SoftwareRenderModule::render(const std::vector<DisplayImage>& displayImages) {
+    SDL_Rect frame = {0, 0, settings.width, settings.height};
+    if (damage.full) damage.rects.assign(1, frame);
+    // Каждая область очищается и собирается заново из пересекающих её изображений
+    for (const auto& rect : damage.rects) {
+        SDL_Rect clip;
+        if (!SDL_IntersectRect(&rect, &frame, &clip)) continue;
+        for (int row = clip.y; row < clip.y + clip.h; row++) {
+            uint32_t* dst = framebuffer.data() + static_cast<size_t>(row) * settings.width + clip.x;
+            std::fill(dst, dst + clip.w, settings.clearColor);
+        }
+        for (const auto& img : displayImages) {
+            if (img.texture < images.size()) {
+                drawImage(images[img.texture], img.x, img.y, img.w, img.h, clip);
+            }
+        }
+    }
+    damage = FrameDamage();
+
+    frameIndex++;
+    if (!settings.frameDumpDirectory.empty()) {
+        char fileName[32];
+        std::snprintf(fileName, sizeof(fileName), "frame_%06llu.ppm", static_cast<unsigned long long>(frameIndex));
+        if (!dumpFrame(settings.frameDumpDirectory + "/" + fileName)) {
+            throw std::runtime_error("Failed to write frame dump to " + settings.frameDumpDirectory);
+        }
+    }
+}
+
+void SoftwareRenderModule::cleanup() {
+    images.clear();
+    textureNames.clear();
+    framebuffer.clear();
+    framebuffer.shrink_to_fit();
+}
+
+TextureHandle SoftwareRenderModule::loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps) {
+    TextureHandle handle = textureNames.intern(imageName);
+    if (handle >= images.size()) images.resize(handle + 1);
+    if (images[handle].pixels.empty()) {
+        images[handle] = convertSurface(surface);
+        if (mipmaps) buildMips(images[handle]);
+    }
+    return handle;
+}
+
+TextureHandle SoftwareRenderModule::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
+    TextureHandle handle = textureNames.intern(textKey);
+    if (handle >= images.size()) images.resize(handle + 1);
+    images[handle] = convertSurface(surface);
+    return handle;
+}
+
+bool SoftwareRenderModule::dumpFrame(const std::string& path) const {
+    if (framebuffer.empty()) return false;
+    return writePPM(path, framebuffer.data(), settings.width, settings.height);
+}
@@ -0,0 +1,72 @@
+#ifndef SOFTWARE_RENDER_MODULE_H
+#define SOFTWARE_RENDER_MODULE_H
+
+#include <SDL2/SDL.h>
+#include "TextureRegistry.h"
+#include "DamageTracker.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Настройки из software.cfg
+struct SoftwareSettings {
+    int width = 1920;
+    int height = 1080;
+    uint32_t clearColor = 0xFF000000; // RGBA в порядке байт R, G, B, A
+    std::string frameDumpDirectory;   // Если задана, каждый кадр сохраняется как frame_NNNNNN.ppm
+};
+
+// Изображение в памяти: RGBA8 с предумноженной альфой
+struct SoftwareImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+    std::vector<SoftwareImage> mips; // Уровни, уменьшенные вдвое бокс-фильтром 2x2; пусто без mipmaps
+};
+
+// Рендеринг без окна в RGBA-буфер в памяти. Нужен для регрессионных тестов
+// и замеров производительности на сборочных агентах без дисплея.
+class SoftwareRenderModule : public IRenderModule {
+private:
+    SoftwareSettings settings;
+    RenderContext context;
+    std::vector<uint32_t> framebuffer;
+    TextureRegistry textureNames;
+    std::vector<SoftwareImage> images; // Индексируется TextureHandle
+    std::vector<int> columnMap;  // Исходный столбец для каждого из w столбцов назначения при масштабировании
+    int columnMapSource = 0;     // Ширина исходника и назначения, для которых построена columnMap
+    int columnMapWidth = 0;
+    std::vector<uint32_t> rowBuffer;
+    uint64_t frameIndex = 0;
+    FrameDamage damage;          // Области следующего кадра; буфер хранит прошлый кадр, остальное не трогается
+
+    static SoftwareImage convertSurface(SDL_Surface* surface);
+    static void buildMips(SoftwareImage& image);
+    void drawImage(const SoftwareImage& image, int x, int y, int w, int h, const SDL_Rect& clip);
+
+public:
+    explicit SoftwareRenderModule(const SoftwareSettings& settings = SoftwareSettings());
+    ~SoftwareRenderModule() override;
+
+    bool init(RenderContext& context) override;
+    void render(const std::vector<DisplayImage>& images) override;
+    void setDamage(const FrameDamage& frameDamage) override { damage = frameDamage; }
+    SDL_Point outputSize() const override { return {settings.width, settings.height}; }
+    void cleanup() override;
+    TextureHandle loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps = false) override;
+    TextureHandle renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) override;
+
+    const uint32_t* pixels() const { return framebuffer.data(); }
+    int width() const { return settings.width; }
+    int height() const { return settings.height; }
+    uint64_t frameCount() const { return frameIndex; }
+    // Сохраняет текущий кадр в двоичный PPM (P6) для сравнения с эталоном
+    bool dumpFrame(const std::string& path) const;
+};
+
+// Наложение строки пикселей с предумноженной альфой: dst = src + dst * (1 - srcA)
+void blendRow(uint32_t* dst, const uint32_t* src, int count);
+// Строка уровня вдвое меньше: каждый пиксель — среднее квадрата 2x2 из строк row0 и row1
+void downsampleRow(uint32_t* dst, const uint32_t* row0, const uint32_t* row1, int srcWidth, int dstWidth);
+
+#endif // SOFTWARE_RENDER_MODULE_H
@@ -0,0 +1,223 @@
+#include "allocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+} // namespace
+
+void VulkanAllocator::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkDeviceSize size) {
+    device = logicalDevice;
+    blockSize = size;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    pools.resize(memoryProperties.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < pools.size(); i++) {
+        pools[i].memoryType = i / 2;
+        pools[i].linear = (i % 2) != 0;
+    }
+}
+
+void VulkanAllocator::shutdown() {
+    for (auto& pool : pools) {
+        for (auto& block : pool.blocks) {
+            if (block.memory != VK_NULL_HANDLE) {
+                freeMemory(block.memory, block.mapped);
+            }
+        }
+    }
+    pools.clear();
+    allocationCount = 0;
+    device = VK_NULL_HANDLE;
+}
+
+uint32_t VulkanAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find suitable memory type");
+}
+
+VkDeviceMemory VulkanAllocator::allocateMemory(uint32_t memoryType, VkDeviceSize size, void** mapped) {
+    if (maxAllocationCount != 0 && allocationCount >= maxAllocationCount) {
+        throw std::runtime_error("Vulkan memory allocation count limit reached");
+    }
+    VkMemoryAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate device memory");
+    }
+    allocationCount++;
+
+    // Память, видимая с CPU, отображается один раз на всё время жизни блока
+    *mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            vkFreeMemory(device, memory, nullptr);
+            allocationCount--;
+            throw std::runtime_error("Failed to map device memory");
+        }
+    }
+    return memory;
+}
+
+void VulkanAllocator::freeMemory(VkDeviceMemory memory, void* mapped) {
+    if (mapped) vkUnmapMemory(device, memory);
+    vkFreeMemory(device, memory, nullptr);
+    allocationCount--;
+}
+
+// Первый подходящий участок; отступ на выравнивание остаётся свободным участком
+bool VulkanAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        VkDeviceSize rangeStart = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second;
+        VkDeviceSize aligned = alignUp(rangeStart, alignment);
+        if (aligned + size > rangeEnd) continue;
+
+        block.freeRanges.erase(it);
+        if (aligned > rangeStart) block.freeRanges[rangeStart] = aligned - rangeStart;
+        if (aligned + size < rangeEnd) block.freeRanges[aligned + size] = rangeEnd - aligned - size;
+        offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void VulkanAllocator::releaseRange(Block& block, VkDeviceSize offset, VkDeviceSize size) {
+    auto next = block.freeRanges.lower_bound(offset);
+    if (next != block.freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+    }
+    if (next != block.freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    block.freeRanges[offset] = size;
+}
+
+VulkanAllocation VulkanAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear) {
+    VulkanAllocation allocation;
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    allocation.pool = memoryType * 2 + (linear ? 1 : 0);
+    allocation.size = requirements.size;
+    Pool& pool = pools[allocation.pool];
+
+    // Крупные ресурсы (фоны во весь экран) получают собственную память, чтобы не дробить блоки
+    if (requirements.size > blockSize / 2) {
+        allocation.memory = allocateMemory(memoryType, requirements.size, &allocation.mapped);
+        pool.dedicatedCount++;
+        pool.dedicatedBytes += requirements.size;
+        return allocation;
+    }
+
+    uint32_t emptySlot = UINT32_MAX;
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        Block& block = pool.blocks[i];
+        if (block.memory == VK_NULL_HANDLE) {
+            if (emptySlot == UINT32_MAX) emptySlot = i;
+            continue;
+        }
+        if (block.size - block.used < requirements.size) continue;
+        if (allocateFromBlock(block, requirements.size, requirements.alignment, allocation.offset)) {
+            allocation.block = i;
+            break;
+        }
+    }
+
+    if (allocation.block == UINT32_MAX) {
+        if (emptySlot == UINT32_MAX) {
+            emptySlot = static_cast<uint32_t>(pool.blocks.size());
+            pool.blocks.emplace_back();
+        }
+        Block& block = pool.blocks[emptySlot];
+        block.memory = allocateMemory(memoryType, blockSize, &block.mapped);
+        block.size = blockSize;
+        block.used = 0;
+        block.allocationCount = 0;
+        block.freeRanges.clear();
+        block.freeRanges[0] = blockSize;
+        allocateFromBlock(block, requirements.size, requirements.alignment, allocation.offset);
+        allocation.block = emptySlot;
+    }
+
+    Block& block = pool.blocks[allocation.block];
+    block.used += requirements.size;
+    block.allocationCount++;
+    allocation.memory = block.memory;
+    if (block.mapped) allocation.mapped = static_cast<char*>(block.mapped) + allocation.offset;
+    return allocation;
+}
+
+void VulkanAllocator::free(VulkanAllocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) return;
+    Pool& pool = pools[allocation.pool];
+    if (allocation.block == UINT32_MAX) {
+        freeMemory(allocation.memory, allocation.mapped);
+        pool.dedicatedCount--;
+        pool.dedicatedBytes -= allocation.size;
+    } else {
+        // Пустой блок не возвращается сразу: промежуточные буферы выделяются каждый кадр
+        Block& block = pool.blocks[allocation.block];
+        releaseRange(block, allocation.offset, allocation.size);
+        block.used -= allocation.size;
+        block.allocationCount--;
+    }
+    allocation = {};
+}
+
+size_t VulkanAllocator::releaseEmptyBlocks() {
+    size_t released = 0;
+    for (auto& pool : pools) {
+        bool keptSpare = false;
+        for (auto& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE || block.allocationCount != 0) continue;
+            if (!keptSpare) {
+                keptSpare = true;
+                continue;
+            }
+            freeMemory(block.memory, block.mapped);
+            block = Block();
+            released++;
+        }
+    }
+    return released;
+}
+
+std::vector<VulkanPoolStats> VulkanAllocator::stats() const {
+    std::vector<VulkanPoolStats> result;
+    for (const auto& pool : pools) {
+        VulkanPoolStats stats;
+        stats.memoryType = pool.memoryType;
+        stats.linear = pool.linear;
+        stats.dedicatedCount = pool.dedicatedCount;
+        stats.dedicatedBytes = pool.dedicatedBytes;
+        for (const auto& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            stats.blockCount++;
+            stats.allocationCount += block.allocationCount;
+            stats.reservedBytes += block.size;
+            stats.usedBytes += block.used;
+            for (const auto& range : block.freeRanges) {
+                stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+            }
+        }
+        if (stats.blockCount != 0 || stats.dedicatedCount != 0) result.push_back(stats);
+    }
+    return result;
+}
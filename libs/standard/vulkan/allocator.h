@@ -0,0 +1,82 @@
+#ifndef VULKAN_ALLOCATOR_H
+#define VULKAN_ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Участок памяти, выданный распределителем
+struct VulkanAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;         // Для HOST_VISIBLE памяти — адрес начала участка
+    uint32_t pool = UINT32_MAX;
+    uint32_t block = UINT32_MAX;    // UINT32_MAX — отдельное выделение под крупный ресурс
+};
+
+// Статистика пула одного типа памяти
+struct VulkanPoolStats {
+    uint32_t memoryType = 0;
+    bool linear = false;                // Буферы; изображения с оптимальной раскладкой живут в отдельном пуле
+    size_t blockCount = 0;
+    size_t allocationCount = 0;
+    VkDeviceSize reservedBytes = 0;     // Память блоков, взятая у драйвера
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize largestFreeRange = 0;
+    size_t dedicatedCount = 0;
+    VkDeviceSize dedicatedBytes = 0;
+};
+
+// Распределитель памяти GPU: ресурсы нарезаются из крупных блоков VkDeviceMemory,
+// чтобы не упираться в maxMemoryAllocationCount и не терять память на выравнивании.
+// Свободные участки блока хранятся упорядоченным списком и сливаются при освобождении.
+class VulkanAllocator {
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE; // VK_NULL_HANDLE — блок возвращён драйверу, слот свободен
+        void* mapped = nullptr;
+        VkDeviceSize size = 0;
+        VkDeviceSize used = 0;
+        size_t allocationCount = 0;
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges; // Смещение -> размер
+    };
+
+    struct Pool {
+        uint32_t memoryType = 0;
+        bool linear = false;
+        std::vector<Block> blocks;
+        size_t dedicatedCount = 0;
+        VkDeviceSize dedicatedBytes = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    VkDeviceSize blockSize = 0;
+    uint32_t maxAllocationCount = 0;
+    uint32_t allocationCount = 0; // Живых объектов VkDeviceMemory
+    std::vector<Pool> pools;      // По два на тип памяти: линейные ресурсы и изображения
+
+    VkDeviceMemory allocateMemory(uint32_t memoryType, VkDeviceSize size, void** mapped);
+    void freeMemory(VkDeviceMemory memory, void* mapped);
+    static bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    static void releaseRange(Block& block, VkDeviceSize offset, VkDeviceSize size);
+
+public:
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize);
+    // Возвращает драйверу всю память; ресурсы к этому моменту должны быть уничтожены
+    void shutdown();
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    // linear — буферы и изображения с линейной раскладкой (учёт bufferImageGranularity)
+    VulkanAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+    void free(VulkanAllocation& allocation);
+
+    // Для долгих сессий: пустые блоки возвращаются драйверу (по одному пустому на пул остаётся про запас)
+    size_t releaseEmptyBlocks();
+
+    std::vector<VulkanPoolStats> stats() const;
+};
+
+#endif // VULKAN_ALLOCATOR_H
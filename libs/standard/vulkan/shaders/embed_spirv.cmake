@@ -0,0 +1,11 @@
+# Превращает SPIR-V в заголовок с массивом слов: cmake -DINPUT=a.spv -DOUTPUT=a.spv.h -DVARIABLE=NAME -P embed_spirv.cmake
+file(READ ${INPUT} hex HEX)
+string(LENGTH "${hex}" length)
+math(EXPR remainder "${length} % 8")
+if(length EQUAL 0 OR NOT remainder EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a valid SPIR-V module")
+endif()
+# Слова SPIR-V хранятся в little-endian
+string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1u," words "${hex}")
+string(REGEX REPLACE "(([^,]*,){8})" "\\1\n    " words "${words}")
+file(WRITE ${OUTPUT} "// Сгенерировано из ${INPUT}\n#pragma once\n#include <cstdint>\n\nstatic const uint32_t ${VARIABLE}[] = {\n    ${words}\n};\n")
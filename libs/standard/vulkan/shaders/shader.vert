@@ -0,0 +1,20 @@
+#version 450
+
+// Общий четырёхугольник [-1, 1] (привязка 0)
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+
+// Данные спрайта, шаг на экземпляр (привязка 1, SpriteInstance)
+layout(location = 2) in vec4 instanceRect;   // x, y, w, h в NDC
+layout(location = 3) in vec4 instanceUvRect; // u0, v0, u1, v1
+layout(location = 4) in uint instanceTextureIndex; // Используется только в режиме bindless
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) flat out uint fragTextureIndex;
+
+void main() {
+    vec2 corner = inPosition * 0.5 + 0.5;
+    gl_Position = vec4(instanceRect.xy + corner * instanceRect.zw, 0.0, 1.0);
+    fragTexCoord = mix(instanceUvRect.xy, instanceUvRect.zw, inTexCoord);
+    fragTextureIndex = instanceTextureIndex;
+}
@@ -1,10 +1,59 @@
 #include "vulkan.h"
 #include <stdexcept>
 #include <fstream>
+#include <cstdio>
 #include <cstring>
 #include <set>
+#include <algorithm>
+#include <iostream>
+#include "Trace.h"
+#include "shader_vert.spv.h"
+#include "shader_frag.spv.h"
+#include "shader_bindless_frag.spv.h"
+
+namespace {
+
+const uint32_t PIPELINE_CACHE_MAGIC = 0x43504E56; // "VNPC"
+const uint64_t PIPELINE_CACHE_MAX_SIZE = 64ull * 1024 * 1024;
+const uint32_t NO_LAYER = UINT32_MAX;
+const std::vector<RenderLayer> NO_LAYERS;
+
+// Заголовок файла кэша конвейеров перед данными vkGetPipelineCacheData
+struct PipelineCacheHeader {
+    uint32_t magic = 0;
+    uint32_t vendorID = 0;
+    uint32_t deviceID = 0;
+    uint32_t driverVersion = 0;
+    uint8_t uuid[VK_UUID_SIZE] = {};
+    uint64_t dataSize = 0;
+    uint64_t checksum = 0;
+};
+
+uint64_t fnv1a(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Собственный заголовок Vulkan внутри данных кэша тоже должен совпадать с устройством
+bool isValidPipelineCacheData(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties) {
+    if (data.size() < 16 + VK_UUID_SIZE) return false;
+    uint32_t fields[4];
+    memcpy(fields, data.data(), sizeof(fields));
+    return fields[0] >= 16 + VK_UUID_SIZE && fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           fields[2] == properties.vendorID && fields[3] == properties.deviceID &&
+           memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
 
-VulkanRenderModule::VulkanRenderModule() : vkInstance(VK_NULL_HANDLE), physicalDevice(VK_NULL_HANDLE), device(VK_NULL_HANDLE) {}
+} // namespace
+
+VulkanRenderModule::VulkanRenderModule(const VulkanSettings& settings)
+    : settings(settings), vkInstance(VK_NULL_HANDLE), physicalDevice(VK_NULL_HANDLE), device(VK_NULL_HANDLE),
+      residency(static_cast<size_t>(settings.textureBudgetMB) * 1024 * 1024, settings.framesInFlight),
+      layerCache(settings.maxCachedLayers, settings.framesInFlight) {}
 
 VulkanRenderModule::~VulkanRenderModule() {
     cleanup();
@@ -40,6 +89,21 @@ bool VulkanRenderModule::init(RenderContext& ctx) {
     // Добавляем отладочные расширения, если нужно
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
+    // На Vulkan 1.0 возможности descriptor indexing запрашиваются через это расширение
+    bool hasProperties2 = false;
+    if (settings.bindless) {
+        uint32_t availableCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+        std::vector<VkExtensionProperties> availableInstanceExtensions(availableCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, availableInstanceExtensions.data());
+        for (const auto& extension : availableInstanceExtensions) {
+            if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+                extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                hasProperties2 = true;
+            }
+        }
+    }
+
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
     createInfo.enabledLayerCount = 0; // Без слоев валидации для простоты
@@ -106,11 +170,38 @@ bool VulkanRenderModule::init(RenderContext& ctx) {
     if (physicalDevice == VK_NULL_HANDLE) {
         throw std::runtime_error("No suitable Vulkan physical device found");
     }
+    bindless = hasProperties2 && queryBindlessSupport();
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    compressionBC = settings.compressedTextures && supportedFeatures.textureCompressionBC;
+    if (settings.incrementalPresent) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+        for (const auto& extension : availableExtensions) {
+            incrementalPresent = incrementalPresent || std::strcmp(extension.extensionName, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME) == 0;
+        }
+    }
+
+    // Семейство только для передачи (DMA) загружает изображения параллельно с отрисовкой
+    transferFamily = graphicsFamily;
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    for (uint32_t i = 0; i < familyCount; i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            transferFamily = i;
+            break;
+        }
+    }
 
     // Создание логического устройства
     float queuePriority = 1.0f;
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily, presentFamily};
+    std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily, presentFamily, transferFamily};
 
     for (uint32_t queueFamily : uniqueQueueFamilies) {
         VkDeviceQueueCreateInfo queueCreateInfo = {};
@@ -122,22 +213,43 @@ bool VulkanRenderModule::init(RenderContext& ctx) {
     }
 
     VkPhysicalDeviceFeatures deviceFeatures = {};
-    const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    deviceFeatures.textureCompressionBC = compressionBC ? VK_TRUE : VK_FALSE;
+    std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    if (incrementalPresent) deviceExtensions.push_back(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-    deviceCreateInfo.enabledExtensionCount = 1;
-    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
     deviceCreateInfo.enabledLayerCount = 0;
 
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT};
+    if (bindless) {
+        deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        deviceCreateInfo.pNext = &indexingFeatures;
+    }
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
     if (vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create Vulkan device");
     }
 
     vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
     vkGetDeviceQueue(device, presentFamily, 0, &presentQueue);
+    vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
+    allocator.init(physicalDevice, device, static_cast<VkDeviceSize>(settings.memoryBlockSizeMB) * 1024 * 1024);
+
+    VkFormatProperties imageFormatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB, &imageFormatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    mipmapBlits = (imageFormatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
 
     // Создание swapchain
     VkSurfaceCapabilitiesKHR capabilities;
@@ -271,42 +383,35 @@ bool VulkanRenderModule::init(RenderContext& ctx) {
         throw std::runtime_error("Failed to create Vulkan command pool");
     }
 
-    // Создание буферов команд
-    commandBuffers.resize(imageCount);
-    VkCommandBufferAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
-    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate Vulkan command buffers");
+    VkCommandPoolCreateInfo transferPoolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    transferPoolInfo.queueFamilyIndex = transferFamily;
+    transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(device, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Vulkan transfer command pool");
     }
 
     // Инициализация ресурсов
+    createStagingRing();
+    textureSampler = createSampler();
     createVertexBuffer();
     createDescriptorSetLayout();
     createDescriptorPool();
+    createPipelineCache();
+    createLayerRenderPass();
     createGraphicsPipeline();
 
-    // Настройка синхронизации
-    imageAvailableSemaphores.resize(2);
-    renderFinishedSemaphores.resize(2);
-    inFlightFences.resize(2);
-    for (size_t i = 0; i < 2; i++) {
-        VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-        VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create Vulkan synchronization objects");
-        }
+    // Ресурсы кадров в полёте и потоки записи команд
+    createFrameContexts();
+    recordingStopping = false;
+    for (uint32_t i = 0; i < settings.recordingThreads; i++) {
+        recordingWorkers.emplace_back(&VulkanRenderModule::recordingWorkerLoop, this, i);
     }
 
     return true;
 }
 
 void VulkanRenderModule::recreateSwapchain() {
+    VNE_TRACE_SCOPE("VulkanRenderModule::recreateSwapchain");
     vkDeviceWaitIdle(device);
 
     // Очистка старых ресурсов
@@ -393,10 +498,44 @@ void VulkanRenderModule::recreateSwapchain() {
 }
 
 void VulkanRenderModule::render(const std::vector<DisplayImage>& images) {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrameIndex], VK_TRUE, UINT64_MAX);
+    renderLayers(images, NO_LAYERS);
+}
+
+void VulkanRenderModule::renderLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) {
+    VNE_TRACE_SCOPE("VulkanRenderModule::render");
+    FrameContext& frame = frames[currentFrameIndex];
+    {
+        VNE_TRACE_SCOPE("vkWaitForFences");
+        vkWaitForFences(device, 1, &frame.inFlight, VK_TRUE, UINT64_MAX);
+    }
+    for (auto& staging : frame.staging) {
+        destroyStagingBuffer(staging);
+    }
+    frame.staging.clear();
+    // Забор этого контекста принадлежит кадру с номером submittedFrames + 1 - frames.size()
+    if (submittedFrames + 1 >= frames.size()) {
+        uint64_t completedFrame = submittedFrames + 1 - frames.size();
+        for (auto it = retiredImages.begin(); it != retiredImages.end();) {
+            if (it->lastFrame > completedFrame) {
+                ++it;
+                continue;
+            }
+            destroyVulkanImage(it->image);
+            it = retiredImages.erase(it);
+        }
+    }
+
+    // Загрузки, накопленные с прошлого кадра, уходят одной отправкой; завершённые публикуются
+    collectUploads(false);
+    updateResidency(images);
+    submitUploads();
 
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrameIndex], VK_NULL_HANDLE, &imageIndex);
+    VkResult result;
+    {
+        VNE_TRACE_SCOPE("vkAcquireNextImageKHR");
+        result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         recreateSwapchain();
         return;
@@ -404,14 +543,19 @@ void VulkanRenderModule::render(const std::vector<DisplayImage>& images) {
         throw std::runtime_error("Failed to acquire swapchain image");
     }
 
-    vkResetFences(device, 1, &inFlightFences[currentFrameIndex]);
-    vkResetCommandBuffer(commandBuffers[imageIndex], 0);
+    vkResetFences(device, 1, &frame.inFlight);
+    vkResetCommandPool(device, frame.commandPool, 0);
 
     VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    if (vkBeginCommandBuffer(commandBuffers[imageIndex], &beginInfo) != VK_SUCCESS) {
+    if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("Failed to begin command buffer");
     }
+    uploadAtlasPages(frame);
+    // Слои готовятся после получения изображения swapchain: обещанные кэшем сборки не пропадут
+    prepareLayers(images, layers);
+    reserveInstances(frame.instances, images.size() + readyLayers.size());
+    recordLayerBuilds(frame, images);
 
     VkRenderPassBeginInfo renderPassInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
     renderPassInfo.renderPass = renderPass;
@@ -422,47 +566,43 @@ void VulkanRenderModule::render(const std::vector<DisplayImage>& images) {
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
 
-    vkCmdBeginRenderPass(commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-    VkBuffer vertexBuffers[] = {vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffers[imageIndex], indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-
-    for (const auto& img : images) {
-        if (vulkanImages.find(img.name) != vulkanImages.end()) {
-            // Преобразуем координаты в нормализованные координаты устройства (NDC)
-            Transform transform = {
-                (float)img.x / windowWidth * 2.0f - 1.0f,
-                -((float)img.y / windowHeight * 2.0f - 1.0f),
-                (float)img.w / windowWidth * 2.0f,
-                (float)img.h / windowHeight * 2.0f
-            };
-            vkCmdPushConstants(commandBuffers[imageIndex], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Transform), &transform);
-            vkCmdBindDescriptorSets(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &vulkanImages[img.name].descriptorSet, 0, nullptr);
-            vkCmdDrawIndexed(commandBuffers[imageIndex], 6, 1, 0, 0, 0);
+    // Тяжёлые сцены записываются частями во вторичные буферы на нескольких потоках
+    uint32_t chunkCount = static_cast<uint32_t>(frame.secondaryBuffers.size());
+    if (chunkCount > 1 && images.size() >= settings.parallelRecordingThreshold) {
+        vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        VkFramebuffer framebuffer = framebuffers[imageIndex];
+        std::function<void(uint32_t)> job = [&](uint32_t chunk) {
+            recordSecondaryChunk(frame, chunk, chunkCount, images, framebuffer);
+        };
+        {
+            VNE_TRACE_SCOPE("Parallel command recording");
+            runRecordingJob(job);
         }
+        vkCmdExecuteCommands(frame.commandBuffer, chunkCount, frame.secondaryBuffers.data());
+    } else {
+        vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        SDL_Rect view = {0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight)};
+        recordSprites(frame.commandBuffer, graphicsPipeline, images, 0, images.size(), frame.instances, view, true);
     }
 
-    vkCmdEndRenderPass(commandBuffers[imageIndex]);
-    if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS) {
+    vkCmdEndRenderPass(frame.commandBuffer);
+    if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("Failed to record command buffer");
     }
 
     VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrameIndex]};
+    VkSemaphore waitSemaphores[] = {frame.imageAvailable};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrameIndex]};
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    VkSemaphore signalSemaphores[] = {frame.renderFinished};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrameIndex]) != VK_SUCCESS) {
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlight) != VK_SUCCESS) {
         throw std::runtime_error("Failed to submit draw command buffer");
     }
 
@@ -472,31 +612,417 @@ void VulkanRenderModule::render(const std::vector<DisplayImage>& images) {
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &swapchain;
     presentInfo.pImageIndices = &imageIndex;
+    // Области задаются от верхнего левого угла изображения, как и в движке, но в пикселях swapchain:
+    // кадр 1920x1080 растягивается на текущий размер окна. Края округляются наружу и обрезаются по изображению
+    VkPresentRegionKHR region = {};
+    VkPresentRegionsKHR regions = {VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR};
+    if (incrementalPresent && !damage.full) {
+        presentRects.clear();
+        const int64_t sourceWidth = static_cast<int64_t>(windowWidth);
+        const int64_t sourceHeight = static_cast<int64_t>(windowHeight);
+        const int64_t targetWidth = swapchainExtent.width;
+        const int64_t targetHeight = swapchainExtent.height;
+        for (const auto& rect : damage.rects) {
+            int64_t x0 = std::clamp<int64_t>(rect.x * targetWidth / sourceWidth, 0, targetWidth);
+            int64_t y0 = std::clamp<int64_t>(rect.y * targetHeight / sourceHeight, 0, targetHeight);
+            int64_t x1 = std::clamp<int64_t>(((rect.x + rect.w) * targetWidth + sourceWidth - 1) / sourceWidth, 0, targetWidth);
+            int64_t y1 = std::clamp<int64_t>(((rect.y + rect.h) * targetHeight + sourceHeight - 1) / sourceHeight, 0, targetHeight);
+            if (x0 >= x1 || y0 >= y1) continue;
+            presentRects.push_back({{static_cast<int32_t>(x0), static_cast<int32_t>(y0)},
+                                    {static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}, 0});
+        }
+        region.rectangleCount = static_cast<uint32_t>(presentRects.size());
+        region.pRectangles = presentRects.data();
+        regions.swapchainCount = 1;
+        regions.pRegions = &region;
+        presentInfo.pNext = &regions;
+    }
+    damage = FrameDamage();
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    {
+        VNE_TRACE_SCOPE("vkQueuePresentKHR");
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         recreateSwapchain();
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to present swapchain image");
     }
 
-    currentFrameIndex = (currentFrameIndex + 1) % 2;
+    currentFrameIndex = (currentFrameIndex + 1) % static_cast<uint32_t>(frames.size());
+    submittedFrames++;
 }
 
-void VulkanRenderModule::cleanup() {
-    vkDeviceWaitIdle(device);
+const VulkanImage* VulkanRenderModule::spriteSource(TextureHandle handle, float uvRect[4]) const {
+    const VulkanImage* source = nullptr;
+    if (const AtlasRegion* region = atlas.find(handle)) {
+        // Страница атласа создаётся при первой выгрузке, до этого регион рисовать нечем
+        if (region->page < atlasPages.size()) source = &atlasPages[region->page];
+        uvRect[0] = region->u0;
+        uvRect[1] = region->v0;
+        uvRect[2] = region->u1;
+        uvRect[3] = region->v1;
+    } else if (handle < vulkanImages.size()) {
+        source = &vulkanImages[handle];
+        uvRect[0] = 0.0f;
+        uvRect[1] = 0.0f;
+        uvRect[2] = 1.0f;
+        uvRect[3] = 1.0f;
+    }
+    return source && source->ready ? source : nullptr;
+}
+
+// Слой рисуется из кэша, только если готовы все его изображения: иначе собранная цель
+// осталась бы без спрайтов, которые догрузятся позже
+void VulkanRenderModule::prepareLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) {
+    readyLayers.clear();
+    imageLayers.assign(images.size(), NO_LAYER);
+    if (!layerCache.enabled()) return;
+
+    SDL_Rect window = {0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight)};
+    float uvRect[4];
+    for (const auto& layer : layers) {
+        if (layer.first + layer.count > images.size()) continue;
+        RenderLayer visible = layer;
+        if (!SDL_IntersectRect(&layer.bounds, &window, &visible.bounds)) continue;
+        bool ready = true;
+        for (size_t i = layer.first; i < layer.first + layer.count && ready; i++) {
+            const DisplayImage& img = images[i];
+            ready = img.texture == INVALID_TEXTURE || img.w <= 0 || img.h <= 0 || spriteSource(img.texture, uvRect) != nullptr;
+        }
+        if (ready) readyLayers.push_back(visible);
+    }
+
+    // Освобождённые ячейки не читает ни один кадр в полёте: кэш держит их framesInFlight кадров
+    layerCache.beginFrame(readyLayers, layerDraws, releasedLayers);
+    for (uint32_t slot : releasedLayers) {
+        destroyLayerTarget(layerTargets[slot]);
+    }
+    if (layerTargets.size() < layerCache.slotCount()) layerTargets.resize(layerCache.slotCount());
+    for (size_t k = 0; k < readyLayers.size(); k++) {
+        const LayerCache::Draw& draw = layerDraws[k];
+        if (draw.slot == LayerCache::NO_SLOT) continue;
+        if (draw.build) {
+            VulkanLayerTarget& target = layerTargets[draw.slot];
+            destroyLayerTarget(target);
+            createLayerTarget(target, static_cast<uint32_t>(readyLayers[k].bounds.w), static_cast<uint32_t>(readyLayers[k].bounds.h));
+        }
+        for (size_t i = readyLayers[k].first; i < readyLayers[k].first + readyLayers[k].count; i++) {
+            imageLayers[i] = static_cast<uint32_t>(k);
+        }
+    }
+}
+
+void VulkanRenderModule::createLayerTarget(VulkanLayerTarget& target, uint32_t width, uint32_t height) {
+    VulkanImage& image = target.image;
+    image.width = width;
+    image.height = height;
+    createImage(width, height, 1, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.allocation);
+    image.view = createImageView(image.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    createImageDescriptor(image);
+    image.ready = true;
+
+    VkFramebufferCreateInfo framebufferInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    framebufferInfo.renderPass = layerRenderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &image.view;
+    framebufferInfo.width = width;
+    framebufferInfo.height = height;
+    framebufferInfo.layers = 1;
+    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &target.framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create layer framebuffer");
+    }
+}
+
+void VulkanRenderModule::destroyLayerTarget(VulkanLayerTarget& target) {
+    if (target.framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(device, target.framebuffer, nullptr);
+    }
+    destroyVulkanImage(target.image);
+    target = {};
+}
+
+// Сборки идут до основного прохода; зависимость в layerRenderPass делает цель читаемой шейдером
+void VulkanRenderModule::recordLayerBuilds(FrameContext& frame, const std::vector<DisplayImage>& images) {
+    for (size_t k = 0; k < readyLayers.size(); k++) {
+        const LayerCache::Draw& draw = layerDraws[k];
+        if (draw.slot == LayerCache::NO_SLOT || !draw.build) continue;
+        VNE_TRACE_SCOPE("Layer build");
+        const RenderLayer& layer = readyLayers[k];
+        const VulkanLayerTarget& target = layerTargets[draw.slot];
+
+        VkRenderPassBeginInfo renderPassInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        renderPassInfo.renderPass = layerRenderPass;
+        renderPassInfo.framebuffer = target.framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = {target.image.width, target.image.height};
+        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 0.0f}}};
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+        vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport = {0.0f, 0.0f, (float)target.image.width, (float)target.image.height, 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, {target.image.width, target.image.height}};
+        vkCmdSetViewport(frame.commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(frame.commandBuffer, 0, 1, &scissor);
+        recordSprites(frame.commandBuffer, layerCompositePipeline, images, layer.first, layer.first + layer.count, frame.instances, layer.bounds, false);
+        vkCmdEndRenderPass(frame.commandBuffer);
+    }
+}
+
+// Спрайты [begin, end) пишутся в экземпляры с того же индекса, так что части кадра не пересекаются.
+// Экземпляр слоя k лежит за спрайтами кадра, по индексу images.size() + k.
+// view — прямоугольник окна, который занимает цель прохода
+void VulkanRenderModule::recordSprites(VkCommandBuffer commandBuffer, VkPipeline pipeline, const std::vector<DisplayImage>& images, size_t begin, size_t end,
+                                       InstanceBuffer& instances, const SDL_Rect& view, bool useLayers) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    VkBuffer vertexBuffers[] = {vertexBuffer, instances.buffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+    // Подряд идущие спрайты с одной текстурой или страницей атласа рисуются одним инстансным вызовом
+    uint32_t instanceCount = static_cast<uint32_t>(begin);
+    uint32_t batchStart = instanceCount;
+    VkDescriptorSet batchSet = VK_NULL_HANDLE;
+    for (size_t i = begin; i < end; i++) {
+        const DisplayImage& img = images[i];
+        uint32_t layer = useLayers ? imageLayers[i] : NO_LAYER;
+        if (layer != NO_LAYER) {
+            // Слой рисует часть, в которую попало его первое изображение; остальные части его пропускают
+            const RenderLayer& cached = readyLayers[layer];
+            size_t layerEnd = cached.first + cached.count;
+            if (i == cached.first) {
+                if (instanceCount > batchStart) {
+                    vkCmdDrawIndexed(commandBuffer, 6, instanceCount - batchStart, 0, 0, batchStart);
+                }
+                const VulkanImage& target = layerTargets[layerDraws[layer].slot].image;
+                uint32_t instance = static_cast<uint32_t>(images.size() + layer);
+                instances.mapped[instance] = {
+                    {(float)(cached.bounds.x - view.x) / view.w * 2.0f - 1.0f, (float)(cached.bounds.y - view.y) / view.h * 2.0f - 1.0f,
+                     (float)cached.bounds.w / view.w * 2.0f, (float)cached.bounds.h / view.h * 2.0f},
+                    {0.0f, 0.0f, 1.0f, 1.0f},
+                    target.bindlessIndex
+                };
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layerPipeline);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &target.descriptorSet, 0, nullptr);
+                vkCmdDrawIndexed(commandBuffer, 6, 1, 0, 0, instance);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                batchSet = target.descriptorSet;
+            }
+            // Индексы экземпляров пропущенных спрайтов остаются неиспользованными
+            size_t last = std::min(layerEnd, end);
+            instanceCount = static_cast<uint32_t>(last);
+            batchStart = instanceCount;
+            i = last - 1;
+            continue;
+        }
+        // В режиме bindless набор дескрипторов общий, и весь кадр уходит одним вызовом
+        float uvRect[4];
+        const VulkanImage* source = spriteSource(img.texture, uvRect);
+        if (!source) continue;
+        VkDescriptorSet set = source->descriptorSet;
+        if (set != batchSet) {
+            if (instanceCount > batchStart) {
+                vkCmdDrawIndexed(commandBuffer, 6, instanceCount - batchStart, 0, 0, batchStart);
+            }
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &set, 0, nullptr);
+            batchSet = set;
+            batchStart = instanceCount;
+        }
+        // Преобразуем координаты в нормализованные координаты устройства (NDC)
+        instances.mapped[instanceCount++] = {
+            {(float)(img.x - view.x) / view.w * 2.0f - 1.0f, (float)(img.y - view.y) / view.h * 2.0f - 1.0f,
+             (float)img.w / view.w * 2.0f, (float)img.h / view.h * 2.0f},
+            {uvRect[0], uvRect[1], uvRect[2], uvRect[3]},
+            source->bindlessIndex
+        };
+    }
+    if (instanceCount > batchStart) {
+        vkCmdDrawIndexed(commandBuffer, 6, instanceCount - batchStart, 0, 0, batchStart);
+    }
+}
+
+void VulkanRenderModule::recordSecondaryChunk(FrameContext& frame, uint32_t chunk, uint32_t chunkCount, const std::vector<DisplayImage>& images, VkFramebuffer framebuffer) {
+    size_t begin = images.size() * chunk / chunkCount;
+    size_t end = images.size() * (chunk + 1) / chunkCount;
+    vkResetCommandPool(device, frame.recordingPools[chunk], 0);
+
+    VkCommandBufferInheritanceInfo inheritance = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance.renderPass = renderPass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = framebuffer;
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    VkCommandBuffer commandBuffer = frame.secondaryBuffers[chunk];
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin secondary command buffer");
+    }
+    SDL_Rect view = {0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight)};
+    recordSprites(commandBuffer, graphicsPipeline, images, begin, end, frame.instances, view, true);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record secondary command buffer");
+    }
+}
+
+// Часть 0 выполняется на вызывающем потоке; возврат — когда все части записаны
+void VulkanRenderModule::runRecordingJob(const std::function<void(uint32_t)>& job) {
+    {
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        recordingJob = &job;
+        recordingPending = static_cast<uint32_t>(recordingWorkers.size());
+        recordingError = nullptr;
+        recordingGeneration++;
+    }
+    recordingWake.notify_all();
+
+    std::exception_ptr error;
+    try {
+        job(0);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    std::unique_lock<std::mutex> lock(recordingMutex);
+    recordingDone.wait(lock, [this] { return recordingPending == 0; });
+    recordingJob = nullptr;
+    if (!error) error = recordingError;
+    if (error) std::rethrow_exception(error);
+}
+
+void VulkanRenderModule::recordingWorkerLoop(uint32_t index) {
+    VNE_TRACE_THREAD_NAME("Vulkan recording");
+    uint64_t seenGeneration = 0;
+    while (true) {
+        const std::function<void(uint32_t)>* job;
+        {
+            std::unique_lock<std::mutex> lock(recordingMutex);
+            recordingWake.wait(lock, [&] { return recordingStopping || recordingGeneration != seenGeneration; });
+            if (recordingStopping) return;
+            seenGeneration = recordingGeneration;
+            job = recordingJob;
+        }
+        std::exception_ptr error;
+        try {
+            (*job)(index + 1);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        if (error && !recordingError) recordingError = error;
+        if (--recordingPending == 0) recordingDone.notify_one();
+    }
+}
+
+void VulkanRenderModule::stopRecordingWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        recordingStopping = true;
+    }
+    recordingWake.notify_all();
+    for (auto& worker : recordingWorkers) {
+        worker.join();
+    }
+    recordingWorkers.clear();
+}
+
+void VulkanRenderModule::createFrameContexts() {
+    frames.resize(std::max(1u, settings.framesInFlight));
+    currentFrameIndex = 0;
+    uint32_t chunkCount = settings.recordingThreads + 1;
+    for (auto& frame : frames) {
+        VkCommandPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        poolInfo.queueFamilyIndex = graphicsFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create Vulkan command pool");
+        }
+        VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate Vulkan command buffers");
+        }
+
+        if (chunkCount > 1) {
+            frame.recordingPools.resize(chunkCount);
+            frame.secondaryBuffers.resize(chunkCount);
+            for (uint32_t i = 0; i < chunkCount; i++) {
+                if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.recordingPools[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create Vulkan command pool");
+                }
+                allocInfo.commandPool = frame.recordingPools[i];
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                if (vkAllocateCommandBuffers(device, &allocInfo, &frame.secondaryBuffers[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate Vulkan command buffers");
+                }
+            }
+        }
 
-    for (size_t i = 0; i < 2; i++) {
-        if (imageAvailableSemaphores[i] != VK_NULL_HANDLE) {
-            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+        VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.imageAvailable) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.renderFinished) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, nullptr, &frame.inFlight) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create Vulkan synchronization objects");
+        }
+        reserveInstances(frame.instances, 256);
+    }
+}
+
+// Вызывается после vkDeviceWaitIdle: ни один кадр уже не выполняется
+void VulkanRenderModule::destroyFrameContexts() {
+    for (auto& frame : frames) {
+        for (auto& staging : frame.staging) {
+            destroyStagingBuffer(staging);
+        }
+        destroyInstanceBuffer(frame.instances);
+        if (frame.imageAvailable != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, frame.imageAvailable, nullptr);
         }
-        if (renderFinishedSemaphores[i] != VK_NULL_HANDLE) {
-            vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+        if (frame.renderFinished != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, frame.renderFinished, nullptr);
         }
-        if (inFlightFences[i] != VK_NULL_HANDLE) {
-            vkDestroyFence(device, inFlightFences[i], nullptr);
+        if (frame.inFlight != VK_NULL_HANDLE) {
+            vkDestroyFence(device, frame.inFlight, nullptr);
+        }
+        for (auto pool : frame.recordingPools) {
+            vkDestroyCommandPool(device, pool, nullptr);
+        }
+        if (frame.commandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device, frame.commandPool, nullptr);
         }
     }
+    frames.clear();
+}
+
+void VulkanRenderModule::cleanup() {
+    stopRecordingWorkers();
+    vkDeviceWaitIdle(device);
+
+    // Неотправленный пакет отбрасывается, отправленные уже завершены после vkDeviceWaitIdle
+    if (recordingUploads.transferCommands != VK_NULL_HANDLE) {
+        vkEndCommandBuffer(recordingUploads.transferCommands);
+        recordingUploads.fence = VK_NULL_HANDLE;
+        submittedUploads.push_back(std::move(recordingUploads));
+        recordingUploads = {};
+    }
+    collectUploads(true);
+    for (auto& target : layerTargets) {
+        destroyLayerTarget(target);
+    }
+    layerTargets.clear();
+    layerCache.clear();
+    destroyFrameContexts();
+    destroyStagingRing();
+    if (transferCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device, transferCommandPool, nullptr);
+        transferCommandPool = VK_NULL_HANDLE;
+    }
+
     if (commandPool != VK_NULL_HANDLE) {
         vkDestroyCommandPool(device, commandPool, nullptr);
     }
@@ -505,15 +1031,27 @@ void VulkanRenderModule::cleanup() {
             vkDestroyFramebuffer(device, fb, nullptr);
         }
     }
-    if (graphicsPipeline != VK_NULL_HANDLE) {
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    savePipelineCache();
+    if (pipelineCache != VK_NULL_HANDLE) {
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        pipelineCache = VK_NULL_HANDLE;
     }
+    for (VkPipeline pipeline : {graphicsPipeline, layerCompositePipeline, layerPipeline}) {
+        if (pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+    }
+    graphicsPipeline = layerCompositePipeline = layerPipeline = VK_NULL_HANDLE;
     if (pipelineLayout != VK_NULL_HANDLE) {
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
     }
     if (renderPass != VK_NULL_HANDLE) {
         vkDestroyRenderPass(device, renderPass, nullptr);
     }
+    if (layerRenderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(device, layerRenderPass, nullptr);
+        layerRenderPass = VK_NULL_HANDLE;
+    }
     for (auto& imageView : swapchainImageViews) {
         if (imageView != VK_NULL_HANDLE) {
             vkDestroyImageView(device, imageView, nullptr);
@@ -522,39 +1060,47 @@ void VulkanRenderModule::cleanup() {
     if (swapchain != VK_NULL_HANDLE) {
         vkDestroySwapchainKHR(device, swapchain, nullptr);
     }
-    if (descriptorPool != VK_NULL_HANDLE) {
-        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    if (textureSampler != VK_NULL_HANDLE) {
+        vkDestroySampler(device, textureSampler, nullptr);
+        textureSampler = VK_NULL_HANDLE;
     }
+    for (auto& pool : descriptorPools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    descriptorPools.clear();
+    bindlessSet = VK_NULL_HANDLE;
+    nextBindlessSlot = 0;
+    freeBindlessSlots.clear();
     if (descriptorSetLayout != VK_NULL_HANDLE) {
         vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
     }
     if (vertexBuffer != VK_NULL_HANDLE) {
         vkDestroyBuffer(device, vertexBuffer, nullptr);
     }
-    if (vertexBufferMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
-    }
+    allocator.free(vertexBufferAllocation);
     if (indexBuffer != VK_NULL_HANDLE) {
         vkDestroyBuffer(device, indexBuffer, nullptr);
     }
-    if (indexBufferMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, indexBufferMemory, nullptr);
-    }
+    allocator.free(indexBufferAllocation);
     for (auto& img : vulkanImages) {
-        if (img.second.sampler != VK_NULL_HANDLE) {
-            vkDestroySampler(device, img.second.sampler, nullptr);
-        }
-        if (img.second.view != VK_NULL_HANDLE) {
-            vkDestroyImageView(device, img.second.view, nullptr);
-        }
-        if (img.second.image != VK_NULL_HANDLE) {
-            vkDestroyImage(device, img.second.image, nullptr);
-        }
-        if (img.second.memory != VK_NULL_HANDLE) {
-            vkFreeMemory(device, img.second.memory, nullptr);
-        }
-    }
+        destroyVulkanImage(img);
+    }
+    for (auto& retired : retiredImages) {
+        destroyVulkanImage(retired.image);
+    }
+    retiredImages.clear();
+    submittedFrames = 0;
+    for (auto& page : atlasPages) {
+        destroyVulkanImage(page);
+    }
+    vulkanImages.clear();
+    atlasPages.clear();
+    freeDescriptorSets.clear();
+    residency.clear();
+    atlas.clear();
+    textureNames.clear();
     if (device != VK_NULL_HANDLE) {
+        allocator.shutdown();
         vkDestroyDevice(device, nullptr);
     }
     if (vkInstance != VK_NULL_HANDLE && surface != VK_NULL_HANDLE) {
@@ -569,36 +1115,494 @@ void VulkanRenderModule::cleanup() {
     }
 }
 
-void VulkanRenderModule::loadImage(const std::string& imageName, SDL_Surface* surface) {
-    if (vulkanImages.find(imageName) == vulkanImages.end()) {
-        vulkanImages[imageName] = createVulkanImageFromSurface(surface);
+TextureHandle VulkanRenderModule::loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps) {
+    TextureHandle handle = textureNames.intern(imageName);
+    if (handle >= vulkanImages.size()) vulkanImages.resize(handle + 1);
+    // Изображения с mip-уровнями в атлас не попадают: уменьшенные уровни захватили бы соседей по странице
+    if (mipmaps && mipmapBlits) {
+        if (vulkanImages[handle].image == VK_NULL_HANDLE && !atlas.find(handle)) {
+            uint32_t mipLevels = 1;
+            while ((static_cast<uint32_t>(std::max(surface->w, surface->h)) >> mipLevels) > 0) mipLevels++;
+            vulkanImages[handle] = createVulkanImage(surface->w, surface->h, VK_FORMAT_R8G8B8A8_SRGB, mipLevels);
+            queueImageUpload(handle, surface);
+            trackImage(handle, true, true);
+        }
+        return handle;
+    }
+    // Мелкие изображения упаковываются в атлас и выгружаются на GPU пачкой в начале кадра,
+    // остальные ставятся в пакет загрузок и появляются после его завершения
+    if (vulkanImages[handle].image == VK_NULL_HANDLE && !atlas.find(handle) && !atlas.insert(handle, surface)) {
+        vulkanImages[handle] = createVulkanImage(surface->w, surface->h);
+        queueImageUpload(handle, surface);
+        trackImage(handle, true);
+    }
+    return handle;
+}
+
+TextureHandle VulkanRenderModule::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
+    TextureHandle handle = textureNames.intern(textKey);
+    if (handle >= vulkanImages.size()) vulkanImages.resize(handle + 1);
+    // Прежнее отдельное изображение откладывается до завершения кадров, которые могут его читать;
+    // текст в атласе заменяется на месте
+    if (vulkanImages[handle].image != VK_NULL_HANDLE) {
+        // Загрузки пакета, ещё не отправленного, уйдут вместе со следующим кадром
+        retiredImages.push_back({vulkanImages[handle], submittedFrames + 1});
+        vulkanImages[handle] = {};
+        residency.remove(handle);
+    }
+    if (!atlas.insert(handle, surface)) {
+        vulkanImages[handle] = createVulkanImage(surface->w, surface->h);
+        queueImageUpload(handle, surface);
+        trackImage(handle, false);
+    }
+    return handle;
+}
+
+uint32_t VulkanRenderModule::compressedFormats() const {
+    return compressionBC ? textureFormatBit(TextureFormat::BC1) | textureFormatBit(TextureFormat::BC3) : 0;
+}
+
+TextureHandle VulkanRenderModule::loadCompressedImage(const std::string& imageName, const CompressedTexture& texture) {
+    if (!(compressedFormats() & textureFormatBit(texture.format))) {
+        return IRenderModule::loadCompressedImage(imageName, texture);
+    }
+    TextureHandle handle = textureNames.intern(imageName);
+    if (handle >= vulkanImages.size()) vulkanImages.resize(handle + 1);
+    // Блоки копируются в изображение как есть; в атлас они не попадают, его страницы хранятся в RGBA
+    if (vulkanImages[handle].image == VK_NULL_HANDLE && !atlas.find(handle)) {
+        VkFormat format = texture.format == TextureFormat::BC1 ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+        vulkanImages[handle] = createVulkanImage(texture.width, texture.height, format);
+        StagingBuffer staging = allocateStaging(texture.blocks.size());
+        memcpy(staging.mapped, texture.blocks.data(), texture.blocks.size());
+        recordImageUpload(handle, staging, texture.width, texture.height);
+        trackImage(handle, true);
+    }
+    return handle;
+}
+
+bool VulkanRenderModule::hasPendingUploads() const {
+    return recordingUploads.transferCommands != VK_NULL_HANDLE || !submittedUploads.empty();
+}
+
+void VulkanRenderModule::queueImageUpload(TextureHandle handle, SDL_Surface* surface) {
+    SDL_Surface* rgba = surface;
+    if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+        rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        if (!rgba) {
+            throw std::runtime_error("Failed to convert surface: " + std::string(SDL_GetError()));
+        }
+    }
+    StagingBuffer staging = createStagingBuffer(static_cast<const uint8_t*>(rgba->pixels), rgba->pitch, rgba->w, rgba->h);
+    uint32_t width = rgba->w;
+    uint32_t height = rgba->h;
+    if (rgba != surface) SDL_FreeSurface(rgba);
+    recordImageUpload(handle, staging, width, height);
+}
+
+void VulkanRenderModule::recordImageUpload(TextureHandle handle, const StagingBuffer& staging, uint32_t width, uint32_t height) {
+    if (recordingUploads.transferCommands == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = transferCommandPool;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &recordingUploads.transferCommands) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate upload command buffer");
+        }
+        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(recordingUploads.transferCommands, &beginInfo);
+    }
+
+    VkCommandBuffer commands = recordingUploads.transferCommands;
+    const VulkanImage& target = vulkanImages[handle];
+    VkImage image = target.image;
+    recordImageBarrier(commands, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    recordCopyBufferToImage(commands, staging, image, width, height);
+    if (transferFamily != graphicsFamily) {
+        // Освобождение владения; доступ на стороне графики задаёт парный барьер в submitUploads().
+        // Mip-уровни строятся уже там: очередь передачи не умеет vkCmdBlitImage
+        VkImageLayout releasedLayout = target.mipLevels > 1 ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        recordImageBarrier(commands, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, releasedLayout,
+                           VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                           transferFamily, graphicsFamily);
+    } else if (target.mipLevels > 1) {
+        recordMipmaps(commands, target);
+    } else {
+        recordImageBarrier(commands, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    recordingUploads.staging.push_back(staging);
+    recordingUploads.textures.push_back(handle);
+    recordingUploads.images.push_back(image);
+    recordingUploads.mipLevels.push_back(target.mipLevels);
+}
+
+void VulkanRenderModule::submitUploads() {
+    UploadBatch& batch = recordingUploads;
+    if (batch.transferCommands == VK_NULL_HANDLE) return;
+    VNE_TRACE_SCOPE("VulkanRenderModule::submitUploads");
+    vkEndCommandBuffer(batch.transferCommands);
+
+    VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    if (vkCreateFence(device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create upload fence");
+    }
+
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.transferCommands;
+    if (transferFamily == graphicsFamily) {
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload command buffer");
+        }
+    } else {
+        VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.transferDone) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload semaphore");
+        }
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &batch.transferDone;
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload command buffer");
+        }
+
+        // Принятие владения графической очередью после завершения копирования
+        VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &batch.acquireCommands) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate upload command buffer");
+        }
+        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(batch.acquireCommands, &beginInfo);
+        for (size_t i = 0; i < batch.textures.size(); i++) {
+            TextureHandle handle = batch.textures[i];
+            VkImage image = batch.images[i];
+            // Заменённое до отправки изображение больше не читается и будет уничтожено; барьер нужен только текущему
+            if (handle >= vulkanImages.size() || vulkanImages[handle].image != image) continue;
+            if (batch.mipLevels[i] > 1) {
+                recordImageBarrier(batch.acquireCommands, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   0, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   transferFamily, graphicsFamily);
+                recordMipmaps(batch.acquireCommands, vulkanImages[handle]);
+                continue;
+            }
+            recordImageBarrier(batch.acquireCommands, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                               transferFamily, graphicsFamily);
+        }
+        vkEndCommandBuffer(batch.acquireCommands);
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquireInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        acquireInfo.waitSemaphoreCount = 1;
+        acquireInfo.pWaitSemaphores = &batch.transferDone;
+        acquireInfo.pWaitDstStageMask = &waitStage;
+        acquireInfo.commandBufferCount = 1;
+        acquireInfo.pCommandBuffers = &batch.acquireCommands;
+        if (vkQueueSubmit(graphicsQueue, 1, &acquireInfo, batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload command buffer");
+        }
+    }
+
+    submittedUploads.push_back(std::move(batch));
+    recordingUploads = {};
+}
+
+void VulkanRenderModule::collectUploads(bool wait) {
+    bool released = false;
+    for (auto it = submittedUploads.begin(); it != submittedUploads.end();) {
+        if (it->fence != VK_NULL_HANDLE) {
+            if (wait) {
+                vkWaitForFences(device, 1, &it->fence, VK_TRUE, UINT64_MAX);
+            } else if (vkGetFenceStatus(device, it->fence) != VK_SUCCESS) {
+                ++it;
+                continue;
+            }
+            for (size_t i = 0; i < it->textures.size(); i++) {
+                TextureHandle handle = it->textures[i];
+                // Заменённое после записи изображение не публикуется: у нового своя загрузка
+                if (handle >= vulkanImages.size() || vulkanImages[handle].image != it->images[i]) continue;
+                vulkanImages[handle].ready = true;
+                residency.setPinned(handle, false);
+            }
+            vkDestroyFence(device, it->fence, nullptr);
+        }
+        for (auto& staging : it->staging) {
+            destroyStagingBuffer(staging);
+        }
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &it->transferCommands);
+        if (it->acquireCommands != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, commandPool, 1, &it->acquireCommands);
+        }
+        if (it->transferDone != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, it->transferDone, nullptr);
+        }
+        it = submittedUploads.erase(it);
+        released = true;
+    }
+    // После крупных загрузок лишние пустые блоки промежуточной памяти возвращаются драйверу
+    if (released) allocator.releaseEmptyBlocks();
+}
+
+void VulkanRenderModule::createStagingRing() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    stagingAlignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+
+    stagingRing = {};
+    stagingRing.size = static_cast<VkDeviceSize>(settings.stagingBufferSizeMB) * 1024 * 1024;
+    VkBufferCreateInfo bufferInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufferInfo.size = stagingRing.size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    // Кольцо читают и очередь передачи, и графическая очередь (атлас, вершинные буферы)
+    uint32_t families[] = {graphicsFamily, transferFamily};
+    if (transferFamily != graphicsFamily) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = families;
+    } else {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &stagingRing.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create staging buffer");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, stagingRing.buffer, &memRequirements);
+    stagingRing.allocation = allocator.allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    vkBindBufferMemory(device, stagingRing.buffer, stagingRing.allocation.memory, stagingRing.allocation.offset);
+}
+
+void VulkanRenderModule::destroyStagingRing() {
+    if (stagingRing.buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, stagingRing.buffer, nullptr);
+    }
+    allocator.free(stagingRing.allocation);
+    stagingRing = {};
+}
+
+bool VulkanRenderModule::allocateFromStagingRing(VkDeviceSize size, StagingBuffer& staging) {
+    StagingRing& ring = stagingRing;
+    if (ring.buffer == VK_NULL_HANDLE || size > ring.size / 2) return false;
+    if (ring.entries.empty()) ring.head = 0;
+
+    VkDeviceSize offset = (ring.head + stagingAlignment - 1) / stagingAlignment * stagingAlignment;
+    if (!ring.entries.empty()) {
+        VkDeviceSize tail = ring.entries.front().begin;
+        if (ring.head > tail) {
+            // Свободны конец буфера и начало до хвоста
+            if (offset + size > ring.size) {
+                if (size > tail) return false;
+                offset = 0;
+            }
+        } else if (offset + size > tail) {
+            return false;
+        }
     }
+
+    ring.entries.push_back({offset, offset + size, false});
+    ring.head = offset + size;
+    staging.buffer = ring.buffer;
+    staging.offset = offset;
+    staging.mapped = static_cast<char*>(ring.allocation.mapped) + offset;
+    staging.ringEntry = ring.firstEntry + ring.entries.size() - 1;
+    return true;
+}
+
+// Кольцо заполнено или данные слишком велики — отдельный буфер на время загрузки
+StagingBuffer VulkanRenderModule::allocateStaging(VkDeviceSize size) {
+    StagingBuffer staging;
+    if (allocateFromStagingRing(size, staging)) return staging;
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.buffer, staging.allocation);
+    staging.mapped = staging.allocation.mapped;
+    return staging;
 }
 
-void VulkanRenderModule::renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) {
-    if (vulkanImages.find(textKey) == vulkanImages.end()) {
-        vulkanImages[textKey] = createVulkanImageFromSurface(surface);
+StagingBuffer VulkanRenderModule::createStagingBuffer(const uint8_t* pixels, size_t pitch, uint32_t width, uint32_t height) {
+    VkDeviceSize rowBytes = static_cast<VkDeviceSize>(width) * 4;
+    StagingBuffer staging = allocateStaging(rowBytes * height);
+    uint8_t* data = static_cast<uint8_t*>(staging.mapped);
+    for (uint32_t row = 0; row < height; row++) {
+        memcpy(data + row * rowBytes, pixels + row * pitch, static_cast<size_t>(rowBytes));
     }
+    return staging;
+}
+
+// Вызывается, когда забор владельца сработал и GPU больше не читает данные
+void VulkanRenderModule::destroyStagingBuffer(StagingBuffer& staging) {
+    if (staging.ringEntry != UINT64_MAX) {
+        StagingRing& ring = stagingRing;
+        ring.entries[staging.ringEntry - ring.firstEntry].retired = true;
+        while (!ring.entries.empty() && ring.entries.front().retired) {
+            ring.entries.pop_front();
+            ring.firstEntry++;
+        }
+    } else {
+        if (staging.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, staging.buffer, nullptr);
+        }
+        allocator.free(staging.allocation);
+    }
+    staging = {};
+}
+
+// Изменённые области страниц атласа копируются в начале командного буфера кадра, до прохода отрисовки
+void VulkanRenderModule::uploadAtlasPages(FrameContext& frame) {
+    VkCommandBuffer commandBuffer = frame.commandBuffer;
+    VNE_TRACE_SCOPE("VulkanRenderModule::uploadAtlasPages");
+    uint32_t pageSize = static_cast<uint32_t>(atlas.getPageSize());
+    for (uint32_t page = 0; page < atlas.pageCount(); page++) {
+        SDL_Rect rect;
+        if (!atlas.takeDirtyRect(page, rect)) continue;
+
+        bool created = page >= atlasPages.size();
+        if (created) {
+            atlasPages.push_back(createVulkanImage(pageSize, pageSize));
+            atlasPages.back().ready = true;
+        }
+
+        const uint32_t* pixels = atlas.pagePixels(page) + static_cast<size_t>(rect.y) * pageSize + rect.x;
+        StagingBuffer staging = createStagingBuffer(reinterpret_cast<const uint8_t*>(pixels), static_cast<size_t>(pageSize) * 4, rect.w, rect.h);
+        frame.staging.push_back(staging);
+
+        VkImage image = atlasPages[page].image;
+        if (created) {
+            recordImageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        } else {
+            // Предыдущие кадры могли ещё читать страницу
+            recordImageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        }
+        recordCopyBufferToImage(commandBuffer, staging, image, rect.w, rect.h, rect.x, rect.y);
+        recordImageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+}
+
+void VulkanRenderModule::destroyVulkanImage(VulkanImage& image) {
+    if (bindless && image.descriptorSet != VK_NULL_HANDLE) {
+        freeBindlessSlots.push_back(image.bindlessIndex);
+    } else if (image.descriptorSet != VK_NULL_HANDLE) {
+        freeDescriptorSets.push_back(image.descriptorSet);
+    }
+    if (image.view != VK_NULL_HANDLE) {
+        vkDestroyImageView(device, image.view, nullptr);
+    }
+    if (image.image != VK_NULL_HANDLE) {
+        vkDestroyImage(device, image.image, nullptr);
+    }
+    allocator.free(image.allocation);
+    image = {};
+}
+
+// Учёт начинается сразу, но вытеснять изображение можно только после завершения загрузки
+void VulkanRenderModule::trackImage(TextureHandle handle, bool reloadable, bool mipmaps) {
+    residency.add(handle, vulkanImages[handle].allocation.size, reloadable, mipmaps);
+    residency.setPinned(handle, true);
+}
+
+// Вызывается после ожидания забора кадра: изображения, не использованные в последних
+// framesInFlight кадрах, уже не читает ни один командный буфер и их можно уничтожить сразу
+void VulkanRenderModule::updateResidency(const std::vector<DisplayImage>& images) {
+    residency.beginFrame();
+    for (const auto& img : images) {
+        if (residency.isEvicted(img.texture)) reloadTexture(img.texture);
+        residency.touch(img.texture);
+    }
+    residency.collect(evictedTextures);
+    for (TextureHandle handle : evictedTextures) {
+        destroyVulkanImage(vulkanImages[handle]);
+    }
+}
+
+// Вытесненное изображение загружается снова тем же путём, что и в первый раз, и появится
+// на экране после завершения пакета загрузок
+void VulkanRenderModule::reloadTexture(TextureHandle handle) {
+    VNE_TRACE_SCOPE("VulkanRenderModule::reloadTexture");
+    const std::string& name = textureNames.name(handle);
+    DecodedImage image = textureSource ? textureSource(name) : DecodedImage();
+    if (!image) {
+        std::cerr << "Failed to reload evicted texture " << name << "\n";
+        residency.reloadFailed(handle);
+        return;
+    }
+    if (image.compressed) {
+        loadCompressedImage(name, *image.compressed);
+    } else {
+        loadImage(name, image.surface, residency.hasMipmaps(handle));
+        SDL_FreeSurface(image.surface);
+    }
+    // Если место нашлось в атласе, отдельное изображение больше не учитывается
+    if (residency.isEvicted(handle)) residency.remove(handle);
 }
 
 // Вспомогательные методы Vulkan
-std::vector<char> VulkanRenderModule::readFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + filename);
+// Кэш из файла принимается, только если он создан тем же устройством и той же версией драйвера
+void VulkanRenderModule::createPipelineCache() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::vector<char> data;
+    if (!settings.pipelineCachePath.empty()) {
+        std::ifstream file(settings.pipelineCachePath, std::ios::binary);
+        PipelineCacheHeader header;
+        if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+            header.magic == PIPELINE_CACHE_MAGIC && header.vendorID == properties.vendorID &&
+            header.deviceID == properties.deviceID && header.driverVersion == properties.driverVersion &&
+            memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 && header.dataSize <= PIPELINE_CACHE_MAX_SIZE) {
+            data.resize(static_cast<size_t>(header.dataSize));
+            if (!file.read(data.data(), data.size()) || fnv1a(data.data(), data.size()) != header.checksum ||
+                !isValidPipelineCacheData(data, properties)) {
+                data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache");
     }
-    size_t size = file.tellg();
-    std::vector<char> buffer(size);
-    file.seekg(0);
-    file.read(buffer.data(), size);
-    file.close();
-    return buffer;
 }
 
-VkShaderModule VulkanRenderModule::createShaderModule(const std::vector<char>& code) {
+// Запись во временный файл и переименование, чтобы прерванный выход не оставил обрезанный кэш
+void VulkanRenderModule::savePipelineCache() {
+    if (pipelineCache == VK_NULL_HANDLE || settings.pipelineCachePath.empty()) return;
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+    data.resize(size);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    PipelineCacheHeader header;
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.checksum = fnv1a(data.data(), data.size());
+
+    std::string tempPath = settings.pipelineCachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) || !file.write(data.data(), data.size())) return;
+    }
+    std::remove(settings.pipelineCachePath.c_str());
+    std::rename(tempPath.c_str(), settings.pipelineCachePath.c_str());
+}
+
+VkShaderModule VulkanRenderModule::createShaderModule(const uint32_t* code, size_t size) {
     VkShaderModuleCreateInfo createInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
     VkShaderModule module;
     if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create shader module");
@@ -606,18 +1610,7 @@ VkShaderModule VulkanRenderModule::createShaderModule(const std::vector<char>& c
     return module;
 }
 
-uint32_t VulkanRenderModule::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-    throw std::runtime_error("Failed to find suitable memory type");
-}
-
-void VulkanRenderModule::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+void VulkanRenderModule::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanAllocation& allocation) {
     VkBufferCreateInfo bufferInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
     bufferInfo.size = size;
     bufferInfo.usage = usage;
@@ -629,22 +1622,17 @@ void VulkanRenderModule::createBuffer(VkDeviceSize size, VkBufferUsageFlags usag
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate buffer memory");
-    }
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    allocation = allocator.allocate(memRequirements, properties, true);
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
 }
 
-void VulkanRenderModule::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+void VulkanRenderModule::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VulkanAllocation& allocation) {
     VkImageCreateInfo imageInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
@@ -659,46 +1647,56 @@ void VulkanRenderModule::createImage(uint32_t width, uint32_t height, VkFormat f
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate image memory");
-    }
-    vkBindImageMemory(device, image, imageMemory, 0);
+    allocation = allocator.allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR);
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
 }
 
-void VulkanRenderModule::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+void VulkanRenderModule::recordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                            VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                                            uint32_t srcFamily, uint32_t dstFamily, uint32_t baseMipLevel, uint32_t levelCount) {
     VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
     barrier.oldLayout = oldLayout;
     barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = levelCount;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
 
-    VkPipelineStageFlags sourceStage, destinationStage;
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
-        throw std::runtime_error("Unsupported layout transition");
-    }
-
-    vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-    endSingleTimeCommands(commandBuffer);
+// Каждый уровень — линейное уменьшение предыдущего вдвое. На входе все уровни в TRANSFER_DST
+// и записан нулевой, на выходе вся цепочка в SHADER_READ_ONLY. Нужна очередь с поддержкой графики.
+void VulkanRenderModule::recordMipmaps(VkCommandBuffer commandBuffer, const VulkanImage& image) {
+    int32_t width = static_cast<int32_t>(image.width);
+    int32_t height = static_cast<int32_t>(image.height);
+    for (uint32_t level = 1; level < image.mipLevels; level++) {
+        recordImageBarrier(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, level - 1, 1);
+        int32_t nextWidth = std::max(1, width / 2);
+        int32_t nextHeight = std::max(1, height / 2);
+        VkImageBlit blit = {};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.srcOffsets[1] = {width, height, 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+        vkCmdBlitImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+        recordImageBarrier(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                           VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, level - 1, 1);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    recordImageBarrier(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.mipLevels - 1, 1);
 }
 
 VkCommandBuffer VulkanRenderModule::beginSingleTimeCommands() {
@@ -717,6 +1715,7 @@ VkCommandBuffer VulkanRenderModule::beginSingleTimeCommands() {
 }
 
 void VulkanRenderModule::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+    VNE_TRACE_SCOPE("VulkanRenderModule::endSingleTimeCommands");
     vkEndCommandBuffer(commandBuffer);
     VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
     submitInfo.commandBufferCount = 1;
@@ -726,20 +1725,18 @@ void VulkanRenderModule::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-void VulkanRenderModule::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+void VulkanRenderModule::recordCopyBufferToImage(VkCommandBuffer commandBuffer, const StagingBuffer& staging, VkImage image, uint32_t width, uint32_t height, int32_t offsetX, int32_t offsetY) {
     VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
+    region.bufferOffset = staging.offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     region.imageSubresource.mipLevel = 0;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
+    region.imageOffset = {offsetX, offsetY, 0};
     region.imageExtent = {width, height, 1};
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region); // Исправлено: ®ion -> region
-    endSingleTimeCommands(commandBuffer);
+    vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
 VkImageView VulkanRenderModule::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
@@ -749,7 +1746,7 @@ VkImageView VulkanRenderModule::createImageView(VkImage image, VkFormat format,
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -776,7 +1773,7 @@ VkSampler VulkanRenderModule::createSampler() {
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // Изображения без mip-уровней ограничены своим единственным уровнем
 
     VkSampler sampler;
     if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
@@ -788,7 +1785,7 @@ VkSampler VulkanRenderModule::createSampler() {
 void VulkanRenderModule::createDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
     samplerLayoutBinding.binding = 1;
-    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.descriptorCount = bindless ? bindlessCapacity : 1;
     samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -796,74 +1793,175 @@ void VulkanRenderModule::createDescriptorSetLayout() {
     VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
     layoutInfo.bindingCount = 1;
     layoutInfo.pBindings = &samplerLayoutBinding;
+
+    // Массив заполняется частично и обновляется, пока набор привязан к кадрам в полёте
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT};
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+    if (bindless) {
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    }
     if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor set layout");
     }
 }
 
 void VulkanRenderModule::createDescriptorPool() {
+    if (!bindless) {
+        addDescriptorPool();
+        return;
+    }
+
+    // Один набор на весь массив текстур
     VkDescriptorPoolSize poolSize = {};
     poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize.descriptorCount = 100;
+    poolSize.descriptorCount = bindlessCapacity;
 
     VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
     poolInfo.poolSizeCount = 1;
     poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = 100;
-    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+    poolInfo.maxSets = 1;
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor pool");
     }
-}
-
-VulkanImage VulkanRenderModule::createVulkanImageFromSurface(SDL_Surface* surface) {
-    VulkanImage image = {};
-    int width = surface->w;
-    int height = surface->h;
-    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    descriptorPools.push_back(pool);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    createBuffer(static_cast<VkDeviceSize>(width * height * 4), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
-
-    void* data;
-    vkMapMemory(device, stagingMemory, 0, width * height * 4, 0, &data);
-    memcpy(data, surface->pixels, static_cast<size_t>(width * height * 4));
-    vkUnmapMemory(device, stagingMemory);
+    VkDescriptorSetAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &bindlessSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate bindless descriptor set");
+    }
+}
 
-    createImage(width, height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.memory);
-    transitionImageLayout(image.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(stagingBuffer, image.image, width, height);
-    transitionImageLayout(image.image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+void VulkanRenderModule::addDescriptorPool() {
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = settings.descriptorPoolSize;
 
-    image.view = createImageView(image.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
-    image.sampler = createSampler();
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = settings.descriptorPoolSize;
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor pool");
+    }
+    descriptorPools.push_back(pool);
+}
 
+VkDescriptorSet VulkanRenderModule::allocateDescriptorSet() {
     VkDescriptorSetAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorPool = descriptorPools.back();
     allocInfo.descriptorSetCount = 1;
     allocInfo.pSetLayouts = &descriptorSetLayout;
-    if (vkAllocateDescriptorSets(device, &allocInfo, &image.descriptorSet) != VK_SUCCESS) {
+    VkDescriptorSet set;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &set) == VK_SUCCESS) {
+        return set;
+    }
+    // Текущий пул исчерпан (без VK_KHR_maintenance1 код ошибки не уточняется) — заводим следующий
+    addDescriptorPool();
+    allocInfo.descriptorPool = descriptorPools.back();
+    if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate descriptor sets");
     }
+    return set;
+}
+
+bool VulkanRenderModule::queryBindlessSupport() {
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceFeatures2KHR");
+    auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceProperties2KHR");
+    if (!getFeatures2 || !getProperties2) return false;
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    std::set<std::string> requiredExtensions = {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, VK_KHR_MAINTENANCE3_EXTENSION_NAME};
+    for (const auto& extension : availableExtensions) {
+        requiredExtensions.erase(extension.extensionName);
+    }
+    if (!requiredExtensions.empty()) return false;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT};
+    VkPhysicalDeviceFeatures2 features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features.pNext = &indexingFeatures;
+    getFeatures2(physicalDevice, &features);
+    if (!indexingFeatures.shaderSampledImageArrayNonUniformIndexing || !indexingFeatures.runtimeDescriptorArray ||
+        !indexingFeatures.descriptorBindingPartiallyBound || !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind ||
+        !indexingFeatures.descriptorBindingUpdateUnusedWhilePending) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT};
+    VkPhysicalDeviceProperties2 properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    properties.pNext = &indexingProperties;
+    getProperties2(physicalDevice, &properties);
+    bindlessCapacity = std::min({settings.maxBindlessTextures,
+                                 indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                 indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                 indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                 indexingProperties.maxDescriptorSetUpdateAfterBindSamplers});
+    return bindlessCapacity > 0;
+}
+
+// Изображение с видом и дескриптором; содержимое загружается отдельно
+VulkanImage VulkanRenderModule::createVulkanImage(uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels) {
+    VNE_TRACE_SCOPE("VulkanRenderModule::createVulkanImage");
+    VulkanImage image = {};
+    image.width = width;
+    image.height = height;
+    image.mipLevels = mipLevels;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (mipLevels > 1) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // Уровни строятся копированием из предыдущего
+    createImage(width, height, mipLevels, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.allocation);
+    image.view = createImageView(image.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+    createImageDescriptor(image);
+    return image;
+}
 
+void VulkanRenderModule::createImageDescriptor(VulkanImage& image) {
     VkDescriptorImageInfo imageInfo = {};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     imageInfo.imageView = image.view;
-    imageInfo.sampler = image.sampler;
+    imageInfo.sampler = textureSampler;
 
     VkWriteDescriptorSet descriptorWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    descriptorWrite.dstSet = image.descriptorSet;
     descriptorWrite.dstBinding = 1;
-    descriptorWrite.dstArrayElement = 0;
     descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrite.descriptorCount = 1;
     descriptorWrite.pImageInfo = &imageInfo;
 
-    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    if (bindless) {
+        // Свободный слот массива заполняется на месте, новый набор не нужен
+        if (!freeBindlessSlots.empty()) {
+            image.bindlessIndex = freeBindlessSlots.back();
+            freeBindlessSlots.pop_back();
+        } else if (nextBindlessSlot < bindlessCapacity) {
+            image.bindlessIndex = nextBindlessSlot++;
+        } else {
+            throw std::runtime_error("Bindless texture array is full");
+        }
+        image.descriptorSet = bindlessSet;
+        descriptorWrite.dstArrayElement = image.bindlessIndex;
+    } else if (!freeDescriptorSets.empty()) {
+        image.descriptorSet = freeDescriptorSets.back();
+        freeDescriptorSets.pop_back();
+        descriptorWrite.dstArrayElement = 0;
+    } else {
+        image.descriptorSet = allocateDescriptorSet();
+        descriptorWrite.dstArrayElement = 0;
+    }
+    descriptorWrite.dstSet = image.descriptorSet;
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingMemory, nullptr);
-    return image;
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
 }
 
 void VulkanRenderModule::createVertexBuffer() {
@@ -878,47 +1976,64 @@ void VulkanRenderModule::createVertexBuffer() {
     VkDeviceSize vertexBufferSize = sizeof(vertices);
     VkDeviceSize indexBufferSize = sizeof(indices);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
-
-    void* data;
-    vkMapMemory(device, stagingMemory, 0, vertexBufferSize, 0, &data);
-    memcpy(data, vertices, static_cast<size_t>(vertexBufferSize));
-    vkUnmapMemory(device, stagingMemory);
-
-    createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-    copyBuffer(stagingBuffer, vertexBuffer, vertexBufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingMemory, nullptr);
-
-    createBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
-    vkMapMemory(device, stagingMemory, 0, indexBufferSize, 0, &data);
-    memcpy(data, indices, static_cast<size_t>(indexBufferSize));
-    vkUnmapMemory(device, stagingMemory);
-
-    createBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-    copyBuffer(stagingBuffer, indexBuffer, indexBufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingMemory, nullptr);
+    StagingBuffer staging = allocateStaging(vertexBufferSize);
+    memcpy(staging.mapped, vertices, static_cast<size_t>(vertexBufferSize));
+    createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferAllocation);
+    copyBuffer(staging.buffer, vertexBuffer, vertexBufferSize, staging.offset);
+    destroyStagingBuffer(staging);
+
+    staging = allocateStaging(indexBufferSize);
+    memcpy(staging.mapped, indices, static_cast<size_t>(indexBufferSize));
+    createBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferAllocation);
+    copyBuffer(staging.buffer, indexBuffer, indexBufferSize, staging.offset);
+    destroyStagingBuffer(staging);
 }
 
-void VulkanRenderModule::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+void VulkanRenderModule::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
     VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = srcOffset;
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion); // Исправлено: ©Region -> copyRegion
     endSingleTimeCommands(commandBuffer);
 }
 
 void VulkanRenderModule::createGraphicsPipeline() {
-    auto vertShaderCode = readFile("vert.spv");
-    auto fragShaderCode = readFile("frag.spv");
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
 
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout");
+    }
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    graphicsPipeline = createSpritePipeline(renderPass, colorBlendAttachment, false);
+
+    // Слой собирается с накоплением альфы, и его цвет получается уже умноженным на неё
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    layerCompositePipeline = createSpritePipeline(layerRenderPass, colorBlendAttachment, true);
+
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    layerPipeline = createSpritePipeline(renderPass, colorBlendAttachment, false);
+}
+
+// Размер цели слоя у каждой сборки свой, поэтому для неё окно вывода задаётся при записи команд
+VkPipeline VulkanRenderModule::createSpritePipeline(VkRenderPass pass, const VkPipelineColorBlendAttachmentState& blend, bool dynamicViewport) {
+    // SPIR-V встроен в исполняемый файл при сборке
+    VkShaderModule vertShaderModule = createShaderModule(SHADER_VERT_SPV, sizeof(SHADER_VERT_SPV));
+    VkShaderModule fragShaderModule = bindless ? createShaderModule(SHADER_BINDLESS_FRAG_SPV, sizeof(SHADER_BINDLESS_FRAG_SPV))
+                                               : createShaderModule(SHADER_FRAG_SPV, sizeof(SHADER_FRAG_SPV));
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -932,12 +2047,15 @@ void VulkanRenderModule::createGraphicsPipeline() {
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-    VkVertexInputBindingDescription bindingDescription = {};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    VkVertexInputBindingDescription bindingDescriptions[2] = {};
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(Vertex);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(SpriteInstance);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-    VkVertexInputAttributeDescription attributeDescriptions[2] = {};
+    VkVertexInputAttributeDescription attributeDescriptions[5] = {};
     attributeDescriptions[0].binding = 0;
     attributeDescriptions[0].location = 0;
     attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
@@ -946,11 +2064,23 @@ void VulkanRenderModule::createGraphicsPipeline() {
     attributeDescriptions[1].location = 1;
     attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
     attributeDescriptions[1].offset = offsetof(Vertex, uv);
+    attributeDescriptions[2].binding = 1;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(SpriteInstance, rect);
+    attributeDescriptions[3].binding = 1;
+    attributeDescriptions[3].location = 3;
+    attributeDescriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[3].offset = offsetof(SpriteInstance, uvRect);
+    attributeDescriptions[4].binding = 1;
+    attributeDescriptions[4].location = 4;
+    attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+    attributeDescriptions[4].offset = offsetof(SpriteInstance, textureIndex);
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = 2;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+    vertexInputInfo.vertexAttributeDescriptionCount = 5;
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly = {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
@@ -987,35 +2117,15 @@ void VulkanRenderModule::createGraphicsPipeline() {
     multisampling.sampleShadingEnable = VK_FALSE;
     multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_TRUE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
     VkPipelineColorBlendStateCreateInfo colorBlending = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.pAttachments = &blend;
 
-    VkPushConstantRange pushConstantRange = {};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(Transform);
-
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create pipeline layout");
-    }
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
 
     VkGraphicsPipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
     pipelineInfo.stageCount = 2;
@@ -1026,14 +2136,85 @@ void VulkanRenderModule::createGraphicsPipeline() {
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = dynamicViewport ? &dynamicState : nullptr;
     pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.renderPass = pass;
     pipelineInfo.subpass = 0;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to create graphics pipeline");
     }
+    return pipeline;
+}
 
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
-}
\ No newline at end of file
+// Проход сборки слоя: цель очищается до прозрачного и после прохода читается шейдером
+void VulkanRenderModule::createLayerRenderPass() {
+    VkAttachmentDescription colorAttachment = {};
+    colorAttachment.format = VK_FORMAT_R8G8B8A8_SRGB;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef = {};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    VkSubpassDependency dependencies[2] = {};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &layerRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create layer render pass");
+    }
+}
+void VulkanRenderModule::reserveInstances(InstanceBuffer& buffer, size_t count) {
+    if (count <= buffer.capacity) return;
+    // Вызывается только после ожидания забора кадра, так что старый буфер GPU уже не читает
+    size_t capacity = std::max<size_t>(buffer.capacity, 256);
+    while (capacity < count) capacity *= 2;
+    destroyInstanceBuffer(buffer);
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(capacity * sizeof(SpriteInstance));
+    createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer.buffer, buffer.allocation);
+    buffer.mapped = static_cast<SpriteInstance*>(buffer.allocation.mapped);
+    buffer.capacity = capacity;
+}
+
+void VulkanRenderModule::destroyInstanceBuffer(InstanceBuffer& buffer) {
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, buffer.buffer, nullptr);
+    }
+    allocator.free(buffer.allocation);
+    buffer = {};
+}
@@ -4,18 +4,97 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
 #include <vulkan/vulkan.h>
-#include <map>
 #include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
 #include <set>
 #include <cstring>
+#include "TextureRegistry.h"
+#include "TextureAtlas.h"
+#include "TextureResidency.h"
+#include "LayerCache.h"
+#include "DamageTracker.h"
+#include "CompressedTexture.h"
+#include "allocator.h"
+
+// Настройки из vulkan.cfg
+struct VulkanSettings {
+    bool bindless = true;                // Массив текстур через descriptor indexing, если устройство его поддерживает
+    uint32_t maxBindlessTextures = 4096; // Размер массива; ограничивается лимитами устройства
+    uint32_t descriptorPoolSize = 256;   // Наборов в одном пуле, когда bindless недоступен
+    uint32_t memoryBlockSizeMB = 64;     // Размер блока VkDeviceMemory, из которого нарезаются ресурсы
+    uint32_t stagingBufferSizeMB = 32;   // Кольцевой буфер загрузок; изображения крупнее половины получают свой буфер
+    std::string pipelineCachePath;       // Файл кэша конвейеров; пусто — кэш не сохраняется между запусками
+    uint32_t framesInFlight = 2;         // Кадров, которые CPU готовит, пока GPU рисует предыдущие
+    uint32_t recordingThreads = 0;       // Дополнительные потоки записи команд; 0 — запись только на кадровом потоке
+    uint32_t parallelRecordingThreshold = 4096; // С какого числа спрайтов запись делится между потоками
+    bool compressedTextures = true;      // Загружать .vtc в форматах BC без распаковки, если устройство их читает
+    uint32_t textureBudgetMB = 512;      // Предел отдельных текстур в видеопамяти; 0 — без ограничения
+    uint32_t maxCachedLayers = 4;        // Изображений для слоёв, найденных движком; 0 — слои рисуются как обычно
+    bool incrementalPresent = true;      // Сообщать композитору изменившиеся области через VK_KHR_incremental_present
+};
 
 // Структура для хранения данных изображения Vulkan
 struct VulkanImage {
     VkImage image = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VulkanAllocation allocation;
     VkImageView view = VK_NULL_HANDLE;
-    VkSampler sampler = VK_NULL_HANDLE;
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE; // В режиме bindless — общий набор для всех изображений
+    uint32_t bindlessIndex = 0;                     // Слот в массиве текстур (только в режиме bindless)
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 1;
+    bool ready = false;                             // Загрузка завершена, изображение можно рисовать
+};
+
+// Промежуточный буфер загрузки; живёт, пока не завершатся читающие его команды
+struct StagingBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;          // Начало данных в buffer
+    void* mapped = nullptr;
+    VulkanAllocation allocation;      // Только у отдельного буфера
+    uint64_t ringEntry = UINT64_MAX;  // Участок кольцевого буфера; UINT64_MAX — буфер отдельный
+};
+
+// Участок кольцевого буфера загрузок, ещё читаемый GPU
+struct StagingRingEntry {
+    VkDeviceSize begin = 0;
+    VkDeviceSize end = 0;
+    bool retired = false; // Забор, за которым следил владелец, сработал
+};
+
+// Постоянно отображённый кольцевой буфер загрузок. Участки освобождаются строго по порядку
+// выделения: хвост сдвигается, когда завершены все более ранние участки.
+struct StagingRing {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VulkanAllocation allocation;
+    VkDeviceSize size = 0;
+    VkDeviceSize head = 0;
+    std::deque<StagingRingEntry> entries;
+    uint64_t firstEntry = 0; // Номер entries.front()
+};
+
+// Пакет загрузок изображений: одна запись команд и одна отправка с забором
+struct UploadBatch {
+    VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+    VkCommandBuffer acquireCommands = VK_NULL_HANDLE; // Принятие владения на графической очереди
+    VkSemaphore transferDone = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    std::vector<StagingBuffer> staging;
+    std::vector<TextureHandle> textures; // Публикуются после сигнала забора
+    std::vector<VkImage> images;         // Изображения textures на момент записи: их могли заменить до завершения
+    std::vector<uint32_t> mipLevels;     // Уровни images; больше одного — цепочка строится при принятии владения
+};
+
+// Цель закэшированного слоя: изображение рисуется в своём проходе и читается как обычная текстура
+struct VulkanLayerTarget {
+    VulkanImage image;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
 };
 
 // Структура вершины для шейдеров
@@ -24,19 +103,44 @@ struct Vertex {
     float uv[2];
 };
 
-// Структура трансформации для push-констант
-struct Transform {
-    float x, y, w, h;
+// Данные одного спрайта: вершинный вход с шагом на экземпляр (см. shaders/shader.vert)
+struct SpriteInstance {
+    float rect[4];   // x, y, w, h в NDC
+    float uvRect[4]; // u0, v0, u1, v1 — область текстуры
+    uint32_t textureIndex; // Слот в массиве текстур в режиме bindless
+};
+
+// Буфер экземпляров одного кадра в полёте, постоянно отображён в память хоста
+struct InstanceBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VulkanAllocation allocation;
+    SpriteInstance* mapped = nullptr;
+    size_t capacity = 0; // В экземплярах
+};
+
+// Всё, чем владеет один кадр в полёте; переиспользуется после сигнала inFlight
+struct FrameContext {
+    VkCommandPool commandPool = VK_NULL_HANDLE;     // Сбрасывается целиком в начале кадра
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    std::vector<VkCommandPool> recordingPools;      // По пулу на поток записи: пулы нельзя делить между потоками
+    std::vector<VkCommandBuffer> secondaryBuffers;  // Вторичные буферы частей кадра
+    VkSemaphore imageAvailable = VK_NULL_HANDLE;
+    VkSemaphore renderFinished = VK_NULL_HANDLE;
+    VkFence inFlight = VK_NULL_HANDLE;
+    InstanceBuffer instances;
+    std::vector<StagingBuffer> staging;             // Загрузки атласа, записанные в этот кадр
 };
 
 class VulkanRenderModule : public IRenderModule {
 private:
+    VulkanSettings settings;
     RenderContext context;
     VkInstance vkInstance = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device = VK_NULL_HANDLE;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
     VkQueue presentQueue = VK_NULL_HANDLE;
+    VkQueue transferQueue = VK_NULL_HANDLE;
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     VkFormat swapchainImageFormat = VK_FORMAT_UNDEFINED;
@@ -45,55 +149,156 @@ private:
     std::vector<VkImageView> swapchainImageViews;
     VkRenderPass renderPass = VK_NULL_HANDLE;
     std::vector<VkFramebuffer> framebuffers;
-    VkCommandPool commandPool = VK_NULL_HANDLE;
-    std::vector<VkCommandBuffer> commandBuffers;
+    VkCommandPool commandPool = VK_NULL_HANDLE; // Разовые команды и принятие владения после загрузок
     VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
     VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+    VkRenderPass layerRenderPass = VK_NULL_HANDLE;
+    VkPipeline layerCompositePipeline = VK_NULL_HANDLE; // Сборка слоя: альфа накапливается для последующего наложения
+    VkPipeline layerPipeline = VK_NULL_HANDLE;          // Вывод слоя на экран: цвет уже умножен на альфу
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
     VkBuffer vertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    VulkanAllocation vertexBufferAllocation;
     VkBuffer indexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
-    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-    std::map<std::string, VulkanImage> vulkanImages;
-    std::vector<VkSemaphore> imageAvailableSemaphores;
-    std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
+    VulkanAllocation indexBufferAllocation;
+    VulkanAllocator allocator;
+    std::vector<VkDescriptorPool> descriptorPools; // Растёт по мере заполнения, если bindless недоступен
+    VkSampler textureSampler = VK_NULL_HANDLE;     // Общий для всех изображений
+    bool bindless = false;
+    bool compressionBC = false; // Включена возможность textureCompressionBC
+    bool mipmapBlits = false;   // Формат изображений поддерживает vkCmdBlitImage с линейной фильтрацией
+    bool incrementalPresent = false; // Включено VK_KHR_incremental_present
+    uint32_t bindlessCapacity = 0;
+    VkDescriptorSet bindlessSet = VK_NULL_HANDLE;
+    uint32_t nextBindlessSlot = 0;
+    std::vector<uint32_t> freeBindlessSlots;
+    std::vector<VkDescriptorSet> freeDescriptorSets; // Наборы уничтоженных изображений, когда bindless недоступен
+    TextureRegistry textureNames;
+    std::vector<VulkanImage> vulkanImages; // Индексируется TextureHandle; пусто для изображений из атласа
+    TextureResidency residency;
+    TextureSource textureSource;
+    std::vector<TextureHandle> evictedTextures;
+    // Заменённые изображения текста: их ещё читают кадры в полёте и пакет загрузок, записанный до замены
+    struct RetiredImage {
+        VulkanImage image;
+        uint64_t lastFrame = 0; // Уничтожается после завершения кадра с этим номером
+    };
+    std::vector<RetiredImage> retiredImages;
+    uint64_t submittedFrames = 0;
+    TextureAtlas atlas;
+    std::vector<VulkanImage> atlasPages;
+    std::vector<FrameContext> frames;
+    LayerCache layerCache;
+    std::vector<VulkanLayerTarget> layerTargets; // Индексируется ячейкой LayerCache
+    std::vector<RenderLayer> readyLayers;        // Слои кадра, все изображения которых готовы
+    std::vector<LayerCache::Draw> layerDraws;
+    std::vector<uint32_t> releasedLayers;
+    std::vector<uint32_t> imageLayers;           // Слой каждого изображения кадра из readyLayers; UINT32_MAX — вне слоёв
+    // Изображение swapchain перерисовывается целиком; damage лишь подсказывает композитору, что показывать заново
+    FrameDamage damage;
+    std::vector<VkRectLayerKHR> presentRects;
     uint32_t currentFrameIndex = 0;
     const float windowWidth = 1920.0f;
     const float windowHeight = 1080.0f;
     uint32_t graphicsFamily = UINT32_MAX;
     uint32_t presentFamily = UINT32_MAX;
+    uint32_t transferFamily = UINT32_MAX; // Отдельное семейство передачи или graphicsFamily
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+    UploadBatch recordingUploads; // Открытый пакет; transferCommands == VK_NULL_HANDLE, пока он пуст
+    std::vector<UploadBatch> submittedUploads;
+    StagingRing stagingRing;
+    VkDeviceSize stagingAlignment = 16;
+
+    // Потоки записи вторичных буферов; поток i записывает часть i + 1, кадровый поток — часть 0
+    std::vector<std::thread> recordingWorkers;
+    std::mutex recordingMutex;
+    std::condition_variable recordingWake;
+    std::condition_variable recordingDone;
+    const std::function<void(uint32_t)>* recordingJob = nullptr;
+    uint64_t recordingGeneration = 0;
+    uint32_t recordingPending = 0;
+    bool recordingStopping = false;
+    std::exception_ptr recordingError;
 
     // Вспомогательные методы Vulkan
-    VkShaderModule createShaderModule(const std::vector<char>& code);
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+    VkShaderModule createShaderModule(const uint32_t* code, size_t size);
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanAllocation& allocation);
+    void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VulkanAllocation& allocation);
+    void recordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                            VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                            uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED,
+                            uint32_t baseMipLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
+    void recordMipmaps(VkCommandBuffer commandBuffer, const VulkanImage& image);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    void recordCopyBufferToImage(VkCommandBuffer commandBuffer, const StagingBuffer& staging, VkImage image, uint32_t width, uint32_t height, int32_t offsetX = 0, int32_t offsetY = 0);
+    void createStagingRing();
+    void destroyStagingRing();
+    bool allocateFromStagingRing(VkDeviceSize size, StagingBuffer& staging);
+    StagingBuffer allocateStaging(VkDeviceSize size);
+    StagingBuffer createStagingBuffer(const uint8_t* pixels, size_t pitch, uint32_t width, uint32_t height);
+    void destroyStagingBuffer(StagingBuffer& staging);
+    void queueImageUpload(TextureHandle handle, SDL_Surface* surface);
+    void recordImageUpload(TextureHandle handle, const StagingBuffer& staging, uint32_t width, uint32_t height);
+    void submitUploads();
+    void collectUploads(bool wait);
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
     VkSampler createSampler();
     void createDescriptorSetLayout();
     void createDescriptorPool();
-    VulkanImage createVulkanImageFromSurface(SDL_Surface* surface);
+    void addDescriptorPool();
+    VkDescriptorSet allocateDescriptorSet();
+    bool queryBindlessSupport();
+    VulkanImage createVulkanImage(uint32_t width, uint32_t height, VkFormat format = VK_FORMAT_R8G8B8A8_SRGB, uint32_t mipLevels = 1);
+    void createImageDescriptor(VulkanImage& image);
+    void destroyVulkanImage(VulkanImage& image);
+    void trackImage(TextureHandle handle, bool reloadable, bool mipmaps = false);
+    void updateResidency(const std::vector<DisplayImage>& images);
+    void reloadTexture(TextureHandle handle);
+    void uploadAtlasPages(FrameContext& frame);
+    void createFrameContexts();
+    void destroyFrameContexts();
+    const VulkanImage* spriteSource(TextureHandle handle, float uvRect[4]) const;
+    void prepareLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers);
+    void createLayerTarget(VulkanLayerTarget& target, uint32_t width, uint32_t height);
+    void destroyLayerTarget(VulkanLayerTarget& target);
+    void recordLayerBuilds(FrameContext& frame, const std::vector<DisplayImage>& images);
+    void recordSprites(VkCommandBuffer commandBuffer, VkPipeline pipeline, const std::vector<DisplayImage>& images, size_t begin, size_t end,
+                       InstanceBuffer& instances, const SDL_Rect& view, bool useLayers);
+    void recordSecondaryChunk(FrameContext& frame, uint32_t chunk, uint32_t chunkCount, const std::vector<DisplayImage>& images, VkFramebuffer framebuffer);
+    void runRecordingJob(const std::function<void(uint32_t)>& job);
+    void recordingWorkerLoop(uint32_t index);
+    void stopRecordingWorkers();
     void createVertexBuffer();
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0);
     void createGraphicsPipeline();
-    std::vector<char> readFile(const std::string& filename);
+    VkPipeline createSpritePipeline(VkRenderPass pass, const VkPipelineColorBlendAttachmentState& blend, bool dynamicViewport);
+    void createLayerRenderPass();
+    void reserveInstances(InstanceBuffer& buffer, size_t count);
+    void destroyInstanceBuffer(InstanceBuffer& buffer);
+    void createPipelineCache();
+    void savePipelineCache();
     void recreateSwapchain();
 
 public:
-    VulkanRenderModule();
+    explicit VulkanRenderModule(const VulkanSettings& settings = VulkanSettings());
     ~VulkanRenderModule() override;
 
     bool init(RenderContext& context) override;
     void render(const std::vector<DisplayImage>& images) override;
+    void renderLayers(const std::vector<DisplayImage>& images, const std::vector<RenderLayer>& layers) override;
     void cleanup() override;
-    void loadImage(const std::string& imageName, SDL_Surface* surface) override;
-    void renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) override;
+    TextureHandle loadImage(const std::string& imageName, SDL_Surface* surface, bool mipmaps = false) override;
+    TextureHandle renderText(const std::string& textKey, SDL_Surface* surface, int x, int y, int w, int h) override;
+    uint32_t compressedFormats() const override;
+    TextureHandle loadCompressedImage(const std::string& imageName, const CompressedTexture& texture) override;
+    bool hasPendingUploads() const override;
+    void setTextureSource(TextureSource source) override { textureSource = std::move(source); }
+    ResidencyStats residencyStats() const override { return residency.stats(); }
+    LayerCacheStats layerCacheStats() const override { return layerCache.stats(); }
+    SDL_Point outputSize() const override { return {static_cast<int>(windowWidth), static_cast<int>(windowHeight)}; }
+    void setDamage(const FrameDamage& frameDamage) override { damage = frameDamage; }
+    std::vector<VulkanPoolStats> memoryStats() const { return allocator.stats(); }
 };
 
 #endif // VULKAN_RENDER_MODULE_H
\ No newline at end of file
@@ -0,0 +1,43 @@
+// Офлайн-компилятор сценариев: script.txt -> script.vnb
+#include "ScriptSource.h"
+#include "BinaryScript.h"
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: vnbc <script> [output.vnb]\n";
+        return 1;
+    }
+
+    std::string inputPath = argv[1];
+    std::string outputPath = argc == 3 ? argv[2] : binaryScriptPath(inputPath);
+    // Вход отображается в память, а выход перезаписывается: один и тот же файл испортился бы при чтении
+    std::error_code ec;
+    if (outputPath == inputPath || std::filesystem::equivalent(inputPath, outputPath, ec)) {
+        std::cerr << "Output path is the input script: " << inputPath << "\n";
+        return 1;
+    }
+
+    MappedScriptSource source;
+    if (!source.open(inputPath)) {
+        std::cerr << "Failed to open script file: " << inputPath << "\n";
+        return 1;
+    }
+
+    std::string error;
+    if (!compileScript(source, outputPath, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    BinaryScriptSource compiled;
+    if (!compiled.open(outputPath)) {
+        std::cerr << "Compiled script failed validation: " << outputPath << "\n";
+        return 1;
+    }
+    std::cout << inputPath << " -> " << outputPath << ": " << compiled.lineCount() << " lines, "
+              << compiled.assetCount() << " asset references\n";
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Офлайн-сжатие текстур: image.png -> image.vtc (BC1 для непрозрачных, BC3 для прозрачных)
+#include "CompressedTexture.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    std::string inputPath;
+    std::string outputPath;
+    std::string formatName = "auto";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            formatName = argv[++i];
+        } else if (inputPath.empty()) {
+            inputPath = arg;
+        } else if (outputPath.empty()) {
+            outputPath = arg;
+        } else {
+            inputPath.clear();
+            break;
+        }
+    }
+    if (inputPath.empty() || (formatName != "auto" && formatName != "bc1" && formatName != "bc3")) {
+        std::cerr << "Usage: vntc <image> [output.vtc] [--format auto|bc1|bc3]\n";
+        return 1;
+    }
+    if (outputPath.empty()) outputPath = compressedTexturePath(inputPath);
+
+    SDL_Surface* surface = IMG_Load(inputPath.c_str());
+    if (!surface) {
+        std::cerr << "Failed to load image " << inputPath << ": " << IMG_GetError() << "\n";
+        return 1;
+    }
+
+    TextureFormat format = formatName == "bc1" ? TextureFormat::BC1
+                         : formatName == "bc3" ? TextureFormat::BC3
+                         : chooseTextureFormat(surface);
+    CompressedTexture texture;
+    std::string error;
+    bool written = compressTexture(surface, format, texture, error) && writeCompressedTexture(texture, outputPath, error);
+    SDL_FreeSurface(surface);
+    if (!written) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    CompressedTexture compressed;
+    if (!readCompressedTexture(outputPath, compressed)) {
+        std::cerr << "Compressed texture failed validation: " << outputPath << "\n";
+        return 1;
+    }
+    std::cout << inputPath << " -> " << outputPath << ": " << compressed.width << "x" << compressed.height << " "
+              << (compressed.format == TextureFormat::BC1 ? "BC1" : "BC3") << ", " << compressed.blocks.size() << " bytes\n";
+    return 0;
+}